@@ -0,0 +1,96 @@
+/*
+ * arith.c
+ */
+
+#include "arith.h"
+
+// The host always builds the routines, for the benchmarks that compare them
+// with the machine operators.
+#if defined(MINCALC_SOFTARITH) || !defined(__FPGA_EXP__)
+
+// Shift and add over the bits of the smaller magnitude, stopping when none
+// are left, so small factors take few steps.
+int32_t arith_mul(int32_t a, int32_t b) {
+    uint32_t x = (uint32_t)a;
+    uint32_t y = (uint32_t)b;
+    uint32_t neg = 0;
+    if (a < 0) {
+        x = 0u - x;
+        neg = ~neg;
+    }
+    if (b < 0) {
+        y = 0u - y;
+        neg = ~neg;
+    }
+    if (x < y) {
+        uint32_t t = x;
+        x = y;
+        y = t;
+    }
+    uint32_t p = 0;
+    while (y != 0) {
+        if (y & 1) {
+            p += x;
+        }
+        x <<= 1;
+        y >>= 1;
+    }
+    return (int32_t)((p ^ neg) - neg);
+}
+
+// Restoring division: the divisor is aligned with the top of the dividend
+// and subtracted back down, one quotient bit per step.  d must not be 0.
+uint32_t arith_udivmod(uint32_t n, uint32_t d, uint32_t *rem) {
+    uint32_t q = 0;
+    int steps = 1;
+    while (d <= (n >> 1) && (d & 0x80000000u) == 0) {
+        d <<= 1;
+        steps++;
+    }
+    while (steps-- > 0) {
+        q <<= 1;
+        if (n >= d) {
+            n -= d;
+            q |= 1;
+        }
+        d >>= 1;
+    }
+    *rem = n;
+    return q;
+}
+
+// Truncating division like the C operators: the remainder has the sign of
+// the dividend.
+int32_t arith_divmod(int32_t a, int32_t b, int32_t *rem) {
+    uint32_t x = a < 0 ? 0u - (uint32_t)a : (uint32_t)a;
+    uint32_t y = b < 0 ? 0u - (uint32_t)b : (uint32_t)b;
+    uint32_t r;
+    uint32_t q = arith_udivmod(x, y, &r);
+    *rem = a < 0 ? (int32_t)(0u - r) : (int32_t)r;
+    return (a < 0) != (b < 0) ? (int32_t)(0u - q) : (int32_t)q;
+}
+
+int32_t arith_div(int32_t a, int32_t b) {
+    int32_t r;
+    return arith_divmod(a, b, &r);
+}
+
+int32_t arith_mod(int32_t a, int32_t b) {
+    int32_t r;
+    arith_divmod(a, b, &r);
+    return r;
+}
+
+// n / 10 as n * 0.8 / 8 with the binary expansion of 0.8 summed by shifts,
+// then corrected by the remainder (Hacker's Delight, 10-10).
+uint32_t arith_div10(uint32_t n) {
+    uint32_t q = (n >> 1) + (n >> 2);
+    q += q >> 4;
+    q += q >> 8;
+    q += q >> 16;
+    q >>= 3;
+    uint32_t r = n - ((q << 3) + (q << 1));
+    return q + ((r + 6) >> 4);
+}
+
+#endif
@@ -0,0 +1,37 @@
+/*
+ * arith.h
+ */
+
+#ifndef MINCALC_ARITH_H
+#define MINCALC_ARITH_H
+
+#include <stdint.h>
+
+// Multiplication and division without multiply or divide instructions.  The
+// FPGA soft core has neither, and the generic libgcc routines the operators
+// compile to there are slow; make SOFTARITH=1 (-DMINCALC_SOFTARITH) makes
+// the evaluator and number output use these instead.  Results wrap around
+// like the machine operators, and INT_MIN / -1 wraps to INT_MIN with
+// remainder 0 as in the evaluator.  Division by zero is left to the caller.
+// make check compares them with the machine operators.
+
+#if defined(MINCALC_SOFTARITH) || !defined(__FPGA_EXP__)
+int32_t arith_mul(int32_t a, int32_t b);
+uint32_t arith_udivmod(uint32_t n, uint32_t d, uint32_t *rem);
+int32_t arith_divmod(int32_t a, int32_t b, int32_t *rem);
+int32_t arith_div(int32_t a, int32_t b);
+int32_t arith_mod(int32_t a, int32_t b);
+uint32_t arith_div10(uint32_t n);
+#endif
+
+#ifdef MINCALC_SOFTARITH
+#define ARITH_MUL(a, b) arith_mul(a, b)
+#define ARITH_DIV(a, b) arith_div(a, b)
+#define ARITH_MOD(a, b) arith_mod(a, b)
+#else
+#define ARITH_MUL(a, b) ((a) * (b))
+#define ARITH_DIV(a, b) ((a) / (b))
+#define ARITH_MOD(a, b) ((a) % (b))
+#endif
+
+#endif /* MINCALC_ARITH_H */
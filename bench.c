@@ -0,0 +1,483 @@
+/*
+ * bench.c
+ */
+
+// Microbenchmarks of the lexer, parsers, evaluator and number output, and an
+// end-to-end run over a generated corpus.  Host only.
+//
+// usage: mincalc-bench [REPORT [MIN_SECONDS]]
+//
+// The report is written to REPORT (default stdout) as tab separated lines
+//
+//     benchmark  unit  count  seconds  units_per_sec  ns_per_unit
+//
+// after a '#' header line naming the revision.  The calculator output of the
+// benchmarks goes to stdout.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "arith.h"
+#include "calc.h"
+#include "cse.h"
+#include "io.h"
+#include "lexer.h"
+#include "parser.h"
+#include "strutils.h"
+
+#ifndef BENCH_REV
+#define BENCH_REV "unknown"
+#endif
+
+typedef struct {
+    const char *name;
+    const char *unit;
+    void (*setup)(void);
+    unsigned long (*run)(void);  // one batch; returns the number of units
+} bench_t;
+
+static volatile int sink;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int count_nodes(const symb_t *symb, int rules_only) {
+    if (symb->type >= 0) {
+        return !rules_only;
+    }
+    int n = 1;
+    int nargs = slr_rule_nargs(~symb->type);
+    if (nargs >= 1) n += count_nodes(symb->arg1, rules_only);
+    if (nargs >= 2) n += count_nodes(symb->arg2, rules_only);
+    if (nargs >= 3) n += count_nodes(symb->arg3, rules_only);
+    return n;
+}
+
+static symb_t *parse_slr(const char *line, int is_svar) {
+    if (is_svar) {
+        init_slr_svar();
+    } else {
+        init_slr_expr();
+    }
+    token_t tok;
+    do {
+        if (get_next_tok(&tok, &line) != 0 || slr_feed_token(&tok) != 0) {
+            return NULL;
+        }
+    } while (tok.type != TOK_EOS);
+    return slr_get_result();
+}
+
+static symb_t *parse_expr(const char *line) {
+    symb_t *symb;
+    if (prec_parse_expr(&symb, &line) != 0 || symb == NULL) {
+        fprintf(stderr, "bench: cannot parse: %s\n", line);
+        exit(1);
+    }
+    return symb;
+}
+
+// The statement loop of main.c.
+static void run_line(const char *line) {
+    int is_svar = mc_strstr(line, ":=") != NULL;
+    symb_t *symb;
+    if (is_svar) {
+        symb = parse_slr(line, 1);
+    } else {
+        const char *p = line;
+        if (prec_parse_expr(&symb, &p) != 0) symb = NULL;
+    }
+    if (symb != NULL) {
+        symb = cse_intern(symb);
+        if (is_svar) {
+            do_svar(symb, line);
+        } else {
+            int ans;
+            if (do_eval(&ans, symb) == 0) {
+                print_int(ans);
+                mc_putchar('\n');
+            }
+        }
+    }
+    clear_slr_mem();
+}
+
+// =====
+// lexer
+// =====
+
+static const char lex_line[] =
+    "x1 := (a + 12345) * b2 - c / 7 % 3 << 2 >>> 1 ^ ~d & (e <= f) | "
+    "g <> h + fn(1, 2, 300000) >= i >> j == 42\n";
+
+static unsigned long bench_lex(void) {
+    unsigned long n = 0;
+    for (int i = 0; i < 100; i++) {
+        const char *p = lex_line;
+        token_t tok;
+        do {
+            get_next_tok(&tok, &p);
+            n++;
+        } while (tok.type != TOK_EOS);
+    }
+    return n;
+}
+
+// =======
+// parsers
+// =======
+
+static const char parse_line[] =
+    "(a + 12345) * b2 - c / 7 % 3 << 2 >>> 1 ^ ~d & (e <= f) | "
+    "g <> h + fn(1, 2, -(3 + x)) >= i >> j == 42\n";
+static token_t parse_toks[64];
+static int parse_ntoks;
+static int parse_nreductions;
+
+static void setup_parse(void) {
+    clear_slr_mem();
+    const char *p = parse_line;
+    parse_ntoks = 0;
+    do {
+        get_next_tok(&parse_toks[parse_ntoks], &p);
+    } while (parse_toks[parse_ntoks++].type != TOK_EOS);
+    // every nonterminal on a right-hand side is kept in the tree, so each
+    // reduction leaves exactly one rule node
+    parse_nreductions = count_nodes(parse_slr(parse_line, 0), 1);
+    clear_slr_mem();
+}
+
+static unsigned long bench_slr(void) {
+    for (int i = 0; i < 100; i++) {
+        init_slr_expr();
+        for (int t = 0; t < parse_ntoks; t++) {
+            slr_feed_token(&parse_toks[t]);
+        }
+        clear_slr_mem();
+    }
+    return 100ul * (unsigned long)parse_nreductions;
+}
+
+static unsigned long bench_prec(void) {
+    for (int i = 0; i < 100; i++) {
+        symb_t *symb;
+        const char *p = parse_line;
+        prec_parse_expr(&symb, &p);
+        clear_slr_mem();
+    }
+    return 100ul * (unsigned long)(parse_ntoks - 1);
+}
+
+// =========
+// evaluator
+// =========
+
+static symb_t *eval_tree;
+static int eval_nnodes;
+
+static void setup_vars(void) {
+    run_line("a := 3");
+    run_line("b := -7");
+    run_line("c := 11");
+    run_line("d := 12345");
+}
+
+static void setup_eval_deep(void) {
+    static char line[1024];
+    char *p = line;
+    clear_slr_mem();
+    setup_vars();
+    for (int i = 0; i < 200; i++) {
+        *p++ = '(';
+    }
+    *p++ = 'a';
+    for (int i = 0; i < 200; i++) {
+        mc_strcpy(p, i % 2 ? "-b)" : "+c)");
+        p += 3;
+    }
+    *p = '\0';
+    eval_tree = parse_expr(line);
+    eval_nnodes = count_nodes(eval_tree, 0);
+}
+
+static char *wide_expr(char *p, int depth, int k) {
+    static const char *const leaves[] = {"a", "b", "c", "d", "17", "-a"};
+    static const char *const ops[] = {"+", "*", "-", "^", "&", "|"};
+    if (depth == 0) {
+        mc_strcpy(p, leaves[k % 6]);
+        return p + mc_strlen(p);
+    }
+    *p++ = '(';
+    p = wide_expr(p, depth - 1, 2 * k);
+    mc_strcpy(p, ops[(depth + k) % 6]);
+    p += mc_strlen(p);
+    p = wide_expr(p, depth - 1, 2 * k + 1);
+    *p++ = ')';
+    *p = '\0';
+    return p;
+}
+
+static void setup_eval_wide(void) {
+    static char line[1024];
+    clear_slr_mem();
+    setup_vars();
+    wide_expr(line, 7, 0);
+    eval_tree = parse_expr(line);
+    eval_nnodes = count_nodes(eval_tree, 0);
+}
+
+static unsigned long bench_eval(void) {
+    int ans;
+    for (int i = 0; i < 100; i++) {
+        do_eval(&ans, eval_tree);
+        sink = ans;
+    }
+    return 100ul * (unsigned long)eval_nnodes;
+}
+
+// ==============
+// function calls
+// ==============
+
+// The language has no conditional, so recursion cannot terminate; the call
+// trees of recursive functions are unrolled into layers of functions that
+// call the layer below.
+
+#define CALL_LAYERS 10
+
+static unsigned long call_ncalls;
+
+static void setup_layers(const char *base, const char *step) {
+    char line[128];
+    clear_slr_mem();
+    setup_vars();
+    sprintf(line, "%s0(x) := %s", base, step);
+    run_line(line);
+    for (int k = 1; k <= CALL_LAYERS; k++) {
+        sprintf(line, base[0] == 'f' ? "f%d(x) := f%d(x) + f%d(x - 1)"
+                                     : "g%d(x) := g%d(g%d(x) + a)",
+                k, k - 1, k - 1);
+        run_line(line);
+    }
+    sprintf(line, "%s%d(a)", base, CALL_LAYERS);
+    eval_tree = parse_expr(line);
+    call_ncalls = (2ul << CALL_LAYERS) - 1;
+}
+
+// fib-shaped: two calls with different arguments per layer
+static void setup_call_fib(void) { setup_layers("f", "x + 1"); }
+
+// ackermann-style: the result of one call is the argument of the next
+static void setup_call_nest(void) { setup_layers("g", "x * 3 + 1"); }
+
+static unsigned long bench_call(void) {
+    int ans;
+    do_eval(&ans, eval_tree);
+    sink = ans;
+    return call_ncalls;
+}
+
+// ==============
+// number output
+// ==============
+
+static unsigned long bench_itoa(void) {
+    char buf[16];
+    unsigned int x = 1;
+    for (int i = 0; i < 1000; i++) {
+        x = x * 1664525u + 1013904223u;
+        // all magnitudes, from one digit to INT_MIN
+        mc_itoa((int)(x >> (x & 31)), buf);
+        sink = buf[0];
+    }
+    return 1000;
+}
+
+static unsigned long bench_print_int(void) {
+    unsigned int x = 1;
+    for (int i = 0; i < 1000; i++) {
+        x = x * 1664525u + 1013904223u;
+        print_int((int)(x >> (x & 31)));
+        mc_putchar('\n');
+    }
+    return 1000;
+}
+
+// ===============
+// soft arithmetic
+// ===============
+
+// The shift-and-add routines of arith.c against the machine operators, on
+// operands of all magnitudes and signs.  The routines are checked against
+// the operators before they are timed.
+
+#define ARITH_OPS 1000
+
+static int32_t arith_a[ARITH_OPS];
+static int32_t arith_b[ARITH_OPS];
+
+static void setup_arith(void) {
+    uint32_t x = 1;
+    for (int i = 0; i < ARITH_OPS; i++) {
+        x = x * 1664525u + 1013904223u;
+        arith_a[i] = (int32_t)(x >> (x & 31));
+        x = x * 1664525u + 1013904223u;
+        uint32_t b = x >> (x & 31);
+        if (x & 0x10000) {
+            b = 0u - b;
+        }
+        // no division by 0, and no INT_MIN / -1
+        arith_b[i] = b == 0 || b == 0xffffffffu ? 7 : (int32_t)b;
+    }
+}
+
+static unsigned long bench_mul_native(void) {
+    uint32_t s = 0;
+    for (int i = 0; i < ARITH_OPS; i++) {
+        s += (uint32_t)arith_a[i] * (uint32_t)arith_b[i];
+    }
+    sink = (int)s;
+    return ARITH_OPS;
+}
+
+static unsigned long bench_mul_soft(void) {
+    int32_t s = 0;
+    for (int i = 0; i < ARITH_OPS; i++) {
+        s ^= arith_mul(arith_a[i], arith_b[i]);
+    }
+    sink = (int)s;
+    return ARITH_OPS;
+}
+
+static unsigned long bench_divmod_native(void) {
+    int32_t s = 0;
+    for (int i = 0; i < ARITH_OPS; i++) {
+        s ^= arith_a[i] / arith_b[i] + arith_a[i] % arith_b[i];
+    }
+    sink = (int)s;
+    return ARITH_OPS;
+}
+
+static unsigned long bench_divmod_soft(void) {
+    int32_t s = 0;
+    for (int i = 0; i < ARITH_OPS; i++) {
+        int32_t r;
+        s ^= arith_divmod(arith_a[i], arith_b[i], &r) + r;
+    }
+    sink = (int)s;
+    return ARITH_OPS;
+}
+
+static unsigned long bench_div10_soft(void) {
+    uint32_t s = 0;
+    for (int i = 0; i < ARITH_OPS; i++) {
+        s ^= arith_div10((uint32_t)arith_a[i]);
+    }
+    sink = (int)s;
+    return ARITH_OPS;
+}
+
+// ==========
+// end to end
+// ==========
+
+#define CORPUS_LINES 1000
+
+static char corpus[CORPUS_LINES][96];
+
+static void setup_corpus(void) {
+    // each form takes a variable, a number, a variable and a number
+    static const char *const forms[] = {
+        "v%u := %u * v%u + %u",
+        "v%u * (%u - v%u) + %u",
+        "sq(v%u) + ad(%u, v%u) * %u",
+        "(v%u << %u %% 31) ^ v%u >>> %u %% 31",
+        "ad(sq(v%u), ad(%u, v%u)) %% %u",
+        "-v%u + ~%u & v%u | %u <= 0",
+    };
+    clear_slr_mem();
+    for (int i = 0; i < 10; i++) {
+        char line[32];
+        sprintf(line, "v%d := %d", i, i * 37 + 1);
+        run_line(line);
+    }
+    run_line("sq(x) := x * x");
+    run_line("ad(x, y) := x + y");
+    unsigned int x = 12345;
+    for (int i = 0; i < CORPUS_LINES; i++) {
+        unsigned int r[5];
+        for (int j = 0; j < 5; j++) {
+            x = x * 1664525u + 1013904223u;
+            r[j] = x >> 16;
+        }
+        sprintf(corpus[i], forms[r[0] % 6], r[1] % 10, r[2] % 100,
+                r[3] % 10, r[4] % 100 + 1);
+    }
+}
+
+static unsigned long bench_e2e(void) {
+    for (int i = 0; i < CORPUS_LINES; i++) {
+        run_line(corpus[i]);
+    }
+    return CORPUS_LINES;
+}
+
+// ======
+// driver
+// ======
+
+static const bench_t benches[] = {
+    {"lex", "token", NULL, bench_lex},
+    {"slr_parse", "reduction", setup_parse, bench_slr},
+    {"prec_parse", "token", setup_parse, bench_prec},
+    {"eval_deep", "node", setup_eval_deep, bench_eval},
+    {"eval_wide", "node", setup_eval_wide, bench_eval},
+    {"call_fib", "call", setup_call_fib, bench_call},
+    {"call_nest", "call", setup_call_nest, bench_call},
+    {"itoa", "number", NULL, bench_itoa},
+    {"print_int", "number", NULL, bench_print_int},
+    {"mul_native", "op", setup_arith, bench_mul_native},
+    {"mul_soft", "op", setup_arith, bench_mul_soft},
+    {"divmod_native", "op", setup_arith, bench_divmod_native},
+    {"divmod_soft", "op", setup_arith, bench_divmod_soft},
+    {"div10_soft", "op", setup_arith, bench_div10_soft},
+    {"end_to_end", "line", setup_corpus, bench_e2e},
+};
+
+int main(int argc, char **argv) {
+    FILE *report = stdout;
+    double min_sec = 0.5;
+    if (argc > 1 && (report = fopen(argv[1], "w")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    if (argc > 2) {
+        min_sec = atof(argv[2]);
+    }
+    fprintf(report, "# mincalc bench rev %s\n", BENCH_REV);
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        const bench_t *b = &benches[i];
+        if (b->setup != NULL) {
+            b->setup();
+        }
+        b->run();  // warm up
+        unsigned long count = 0;
+        double start = now(), elapsed;
+        do {
+            count += b->run();
+            elapsed = now() - start;
+        } while (elapsed < min_sec);
+        fprintf(report, "%s\t%s\t%lu\t%.3f\t%.0f\t%.2f\n", b->name, b->unit,
+                count, elapsed, (double)count / elapsed,
+                elapsed * 1e9 / (double)count);
+        fflush(report);
+    }
+    if (report != stdout) {
+        fclose(report);
+    }
+    return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * builtin.c
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arith.h"
+#include "io.h"
+#include "stats.h"
+
+#include "builtin.h"
+
+#define BUILTIN_DIE(msg)           \
+    do {                           \
+        mc_error("CALC", msg);     \
+        STAT_ERROR(STAT_ERR_CALC); \
+        return 1;                  \
+    } while (0)
+
+// The bit operations compile to single instructions where the host has
+// them.  The FPGA core has none, and the libgcc fallbacks of the intrinsics
+// are not linked there, so it counts with shifts and masks.
+#if defined(__GNUC__) && !defined(__FPGA_EXP__)
+
+static int bit_popc(uint32_t x) { return __builtin_popcount(x); }
+static int bit_clz(uint32_t x) { return x == 0 ? 32 : __builtin_clz(x); }
+static int bit_ctz(uint32_t x) { return x == 0 ? 32 : __builtin_ctz(x); }
+
+#else
+
+static int bit_popc(uint32_t x) {
+    x = x - (x >> 1 & 0x55555555u);
+    x = (x & 0x33333333u) + (x >> 2 & 0x33333333u);
+    x = (x + (x >> 4)) & 0x0f0f0f0fu;
+    x += x >> 8;
+    x += x >> 16;
+    return (int)(x & 0x3f);
+}
+
+static int bit_clz(uint32_t x) {
+    if (x == 0) {
+        return 32;
+    }
+    int n = 0;
+    for (int s = 16; s > 0; s >>= 1) {
+        if (x >> (32 - s) == 0) {
+            n += s;
+            x <<= s;
+        }
+    }
+    return n;
+}
+
+static int bit_ctz(uint32_t x) {
+    if (x == 0) {
+        return 32;
+    }
+    return bit_popc((x & (0u - x)) - 1);
+}
+
+#endif
+
+// Results wrap around like the operators.
+
+static int bi_pow(int *result, const int *args) {
+    if (args[1] < 0) BUILTIN_DIE("negative exponent");
+    uint32_t b = (uint32_t)args[0];
+    uint32_t e = (uint32_t)args[1];
+    uint32_t r = 1;
+    while (e != 0) {
+        if (e & 1) {
+            r = (uint32_t)ARITH_MUL(r, b);
+        }
+        e >>= 1;
+        if (e != 0) {
+            b = (uint32_t)ARITH_MUL(b, b);
+        }
+    }
+    *result = (int)r;
+    return 0;
+}
+
+static int bi_min(int *result, const int *args) {
+    *result = args[0] < args[1] ? args[0] : args[1];
+    return 0;
+}
+
+static int bi_max(int *result, const int *args) {
+    *result = args[0] > args[1] ? args[0] : args[1];
+    return 0;
+}
+
+static uint32_t magnitude(int x) {
+    return x < 0 ? 0u - (uint32_t)x : (uint32_t)x;
+}
+
+static int bi_abs(int *result, const int *args) {
+    *result = (int)magnitude(args[0]);
+    return 0;
+}
+
+// Binary GCD, which needs no division.  gcd(0, 0) is 0.
+static int bi_gcd(int *result, const int *args) {
+    uint32_t a = magnitude(args[0]);
+    uint32_t b = magnitude(args[1]);
+    if (a == 0 || b == 0) {
+        *result = (int)(a | b);
+        return 0;
+    }
+    int shift = bit_ctz(a | b);
+    a >>= bit_ctz(a);
+    do {
+        b >>= bit_ctz(b);
+        if (a > b) {
+            uint32_t t = a;
+            a = b;
+            b = t;
+        }
+        b -= a;
+    } while (b != 0);
+    *result = (int)(a << shift);
+    return 0;
+}
+
+static int bi_popc(int *result, const int *args) {
+    *result = bit_popc((uint32_t)args[0]);
+    return 0;
+}
+
+static int bi_clz(int *result, const int *args) {
+    *result = bit_clz((uint32_t)args[0]);
+    return 0;
+}
+
+static int bi_ctz(int *result, const int *args) {
+    *result = bit_ctz((uint32_t)args[0]);
+    return 0;
+}
+
+// The count is taken modulo 32; the pattern is the one compilers turn into
+// a rotate instruction.
+static int bi_rotl(int *result, const int *args) {
+    uint32_t x = (uint32_t)args[0];
+    unsigned int n = (unsigned int)args[1] & 31;
+    *result = (int)(x << n | x >> (-n & 31));
+    return 0;
+}
+
+static int bi_rotr(int *result, const int *args) {
+    uint32_t x = (uint32_t)args[0];
+    unsigned int n = (unsigned int)args[1] & 31;
+    *result = (int)(x >> n | x << (-n & 31));
+    return 0;
+}
+
+// The reductions are sum(i, lo, hi, expr), prod(i, lo, hi, expr) and
+// fold(i, lo, hi, a, init, expr).
+static const builtin_t builtins[] = {
+    {"pow", 2, BUILTIN_NATIVE, 0, bi_pow},
+    {"min", 2, BUILTIN_NATIVE, 0, bi_min},
+    {"max", 2, BUILTIN_NATIVE, 0, bi_max},
+    {"abs", 1, BUILTIN_NATIVE, 0, bi_abs},
+    {"gcd", 2, BUILTIN_NATIVE, 0, bi_gcd},
+    {"popc", 1, BUILTIN_NATIVE, 0, bi_popc},
+    {"clz", 1, BUILTIN_NATIVE, 0, bi_clz},
+    {"ctz", 1, BUILTIN_NATIVE, 0, bi_ctz},
+    {"rotl", 2, BUILTIN_NATIVE, 0, bi_rotl},
+    {"rotr", 2, BUILTIN_NATIVE, 0, bi_rotr},
+    {"sum", 4, BUILTIN_SUM, 1, NULL},
+    {"prod", 4, BUILTIN_PROD, 1, NULL},
+    {"fold", 6, BUILTIN_FOLD, 1 | 1 << 3, NULL},
+};
+
+#define NBUILTINS (sizeof(builtins) / sizeof(builtins[0]))
+
+const builtin_t *builtin_lookup(const char *name) {
+    for (size_t i = 0; i < NBUILTINS; i++) {
+        const builtin_t *b = &builtins[i];
+        if (b->name[0] == name[0] && b->name[1] == name[1] &&
+            b->name[2] == name[2] && b->name[3] == name[3]) {
+            return b;
+        }
+    }
+    return NULL;
+}
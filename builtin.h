@@ -0,0 +1,32 @@
+/*
+ * builtin.h
+ */
+
+#ifndef MINCALC_BUILTIN_H
+#define MINCALC_BUILTIN_H
+
+// Native functions and reductions.  A call is looked up here before the
+// user's functions, and its arguments are checked when it is parsed.
+
+#define BUILTIN_MAX_ARGS 2  // of native functions
+
+enum builtin_form {
+    BUILTIN_NATIVE,  // fn is called with the values of the arguments
+    BUILTIN_SUM,     // reductions over a range, evaluated by calc.c
+    BUILTIN_PROD,
+    BUILTIN_FOLD,
+};
+
+typedef struct {
+    char name[4];
+    int nargs;
+    enum builtin_form form;
+    // bit k set: argument k is the name of a variable bound by the call
+    unsigned int bound;
+    int (*fn)(int *result, const int *args);  // 1: error reported
+} builtin_t;
+
+// Returns the built-in function called name, or NULL.
+const builtin_t *builtin_lookup(const char *name);
+
+#endif /* MINCALC_BUILTIN_H */
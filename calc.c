@@ -4,61 +4,430 @@
 
 #include <stdint.h>
 
+#ifndef __FPGA_EXP__
+#include <signal.h>
+#include <time.h>
+#endif
+
+#include "arith.h"
+#include "builtin.h"
+#include "cse.h"
 #include "io.h"
 #include "lexer.h"
+#include "profile.h"
+#include "stats.h"
 #include "strutils.h"
+#include "uart.h"
 
 #include "calc.h"
 
 #define CALC_DIE(msg)              \
     do {                           \
-        mc_puts("CALC ERR: " msg); \
+        mc_error("CALC", msg);     \
+        STAT_ERROR(STAT_ERR_CALC); \
         return 1;                  \
     } while (0)
 
 #define NAME_AS_INT(name) (*(int32_t *)(uintptr_t)name)
 
-#define CALC_VAR_SIZE 128
-static var_entry_t vars[CALC_VAR_SIZE];
+// Bindings (x ::= expr).  A bound variable keeps the source of its formula in
+// the fundef buffer.  While a formula is evaluated every global it reads is
+// recorded in its row of deps, so that changing a variable can mark all
+// bindings computed from it dirty; a dirty binding is recomputed when it is
+// next read, after the bindings it reads in turn.  Reads of a base
+// environment are not recorded, as a base does not change.
+#define VAR_DIRTY 1
+#define VAR_BUSY 2
+#define DEPS_WORDS CALC_DEPS_WORDS
 
-var_entry_t *lookup_var(const char *name) {
-    return lookup_var_ctx(name, vars, CALC_VAR_SIZE);
+static calc_env_t default_env = {
+    .fundefs_p = default_env.fundefs,
+    .cur_binding = CALC_VAR_SIZE,  // none
+};
+
+calc_env_t *calc_env = &default_env;
+
+// Set when a function is defined or a name changes meaning: the compiled
+// function bodies are dropped before the next call (see compiled functions).
+static int code_stale;
+
+static int call_depth;  // user function calls, inlined ones not counted
+
+enum calc_args calc_args;
+
+void calc_set_args(enum calc_args mode) {
+    calc_args = mode;
+    code_stale = 1;  // parameters are compiled for the mode
+}
+
+void calc_env_init(calc_env_t *env, const calc_env_t *base) {
+    for (size_t i = 0; i < CALC_VAR_SIZE; i++) {
+        NAME_AS_INT(env->vars[i].name) = 0;
+        env->vars[i].val = 0;
+        env->vars[i].fundef = NULL;
+        env->formulas[i] = NULL;
+        env->var_flags[i] = 0;
+        for (size_t w = 0; w < DEPS_WORDS; w++) {
+            env->deps[i][w] = 0;
+        }
+    }
+    env->fundefs_p = env->fundefs;
+    env->cur_binding = CALC_VAR_SIZE;
+    env->base = base;
+    env->frozen = 0;
+    env->ncheckpoints = 0;
+    env->last_checkpoint = 0;
+    env->log = NULL;
+    code_stale = 1;
+}
+
+static void count_probes(size_t n) {
+    STAT_INC(lookups);
+    mc_stats.probes += n;
+    if (n > mc_stats.max_probe) {
+        mc_stats.max_probe = (unsigned int)n;
+    }
 }
 
 var_entry_t *lookup_var_ctx(const char *name, var_entry_t *ctx,
                             size_t ctx_size) {
+    if (ctx_size == 0) {
+        return NULL;
+    }
     for (size_t i = 0; i < ctx_size; i++) {
         if (NAME_AS_INT(ctx[i].name) == NAME_AS_INT(name)) {
+            count_probes(i + 1);
             return &ctx[i];
         }
     }
+    count_probes(ctx_size);
     return NULL;
 }
 
+static var_entry_t *lookup_own_var(const char *name) {
+    return lookup_var_ctx(name, calc_env->vars, CALC_VAR_SIZE);
+}
+
+static var_entry_t *lookup_base_var(const char *name) {
+    const calc_env_t *base = calc_env->base;
+    if (base == NULL) {
+        return NULL;
+    }
+    return lookup_var_ctx(name, (var_entry_t *)(uintptr_t)base->vars,
+                          CALC_VAR_SIZE);
+}
+
+// Looks name up in the environment, then in its base.  Entries of the base
+// are read-only.
+var_entry_t *lookup_var(const char *name) {
+    var_entry_t *e = lookup_own_var(name);
+    if (e == NULL) {
+        e = lookup_base_var(name);
+    }
+    return e;
+}
+
+static int in_base(const var_entry_t *e) {
+    const calc_env_t *base = calc_env->base;
+    return base != NULL && e >= base->vars && e < base->vars + CALC_VAR_SIZE;
+}
+
+const char *calc_fundef(const var_entry_t *e) {
+    if (in_base(e)) {
+        return calc_env->base->fundefs + ((uintptr_t)e->fundef - 1);
+    }
+    return e->fundef;
+}
+
+// ===========
+// checkpoints
+// ===========
+
+// Checkpoints copy a variable slot on write: save_slot is called before a
+// slot of calc_env is changed, and the first time after the last checkpoint
+// logs its state in the undo log.  Beginning a checkpoint only records the
+// length of the log and of the fundef buffer, which only grows, and the
+// base; rolling back restores the slots logged since, in reverse order, and
+// committing merges them into the enclosing checkpoint.  A slot is logged
+// once per checkpoint it changes in, so the log cannot fill up.  The
+// snapshot of a whole environment cannot be loaded during a checkpoint.
+
+static void save_slot(size_t v) {
+    calc_env_t *env = calc_env;
+    if (env->ncheckpoints == 0) {
+        return;
+    }
+    calc_undo_log_t *log = env->log;
+    uint32_t id = env->checkpoints[env->ncheckpoints - 1].id;
+    if (log->saved_in[v] == id) {
+        return;
+    }
+    calc_undo_t *u = &log->undo[log->nundo++];
+    u->var = env->vars[v];
+    u->formula = env->formulas[v];
+    for (size_t w = 0; w < DEPS_WORDS; w++) {
+        u->deps[w] = env->deps[v][w];
+    }
+    u->saved_in = log->saved_in[v];
+    u->slot = (unsigned short)v;
+    u->flags = env->var_flags[v];
+    log->saved_in[v] = id;
+}
+
+// The log may be uninitialized, or left from before calc_env_init.
+void calc_set_undo_log(calc_undo_log_t *log) {
+    for (size_t i = 0; i < CALC_VAR_SIZE; i++) {
+        log->saved_in[i] = 0;
+    }
+    log->nundo = 0;
+    calc_env->log = log;
+}
+
+int calc_begin(void) {
+    calc_env_t *env = calc_env;
+    if (env->frozen) CALC_DIE("environment is frozen");
+    if (env->log == NULL) CALC_DIE("no undo log");
+    if (env->ncheckpoints == CALC_CHECKPOINTS)
+        CALC_DIE("too many nested checkpoints");
+    calc_checkpoint_t *c = &env->checkpoints[env->ncheckpoints++];
+    c->id = ++env->last_checkpoint;
+    c->nundo = env->log->nundo;
+    c->fundefs_p = env->fundefs_p;
+    c->base = env->base;
+    return 0;
+}
+
+int calc_rollback(void) {
+    calc_env_t *env = calc_env;
+    if (env->ncheckpoints == 0) CALC_DIE("no checkpoint");
+    calc_undo_log_t *log = env->log;
+    const calc_checkpoint_t *c = &env->checkpoints[--env->ncheckpoints];
+    while (log->nundo > c->nundo) {
+        const calc_undo_t *u = &log->undo[--log->nundo];
+        size_t v = u->slot;
+        env->vars[v] = u->var;
+        env->formulas[v] = u->formula;
+        for (size_t w = 0; w < DEPS_WORDS; w++) {
+            env->deps[v][w] = u->deps[w];
+        }
+        env->var_flags[v] = u->flags;
+        log->saved_in[v] = u->saved_in;
+    }
+    env->fundefs_p = c->fundefs_p;
+    env->base = c->base;
+    code_stale = 1;
+    return 0;
+}
+
+int calc_uses_base(const calc_env_t *env, const calc_env_t *base) {
+    if (env->base == base) {
+        return 1;
+    }
+    for (size_t i = 0; i < env->ncheckpoints; i++) {
+        if (env->checkpoints[i].base == base) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// The slots logged for the committed checkpoint hold their state when the
+// enclosing one began too, unless they were logged for that one as well.
+int calc_commit(void) {
+    calc_env_t *env = calc_env;
+    if (env->ncheckpoints == 0) CALC_DIE("no checkpoint");
+    calc_undo_log_t *log = env->log;
+    const calc_checkpoint_t *c = &env->checkpoints[--env->ncheckpoints];
+    if (env->ncheckpoints == 0) {
+        log->nundo = 0;
+        return 0;
+    }
+    uint32_t outer = env->checkpoints[env->ncheckpoints - 1].id;
+    size_t n = c->nundo;
+    for (size_t i = c->nundo; i < log->nundo; i++) {
+        const calc_undo_t *u = &log->undo[i];
+        log->saved_in[u->slot] = outer;
+        if (u->saved_in != outer) {
+            log->undo[n++] = *u;
+        }
+    }
+    log->nundo = n;
+    return 0;
+}
+
 var_entry_t *create_var(const char *name) {
     int32_t n = 0;
-    var_entry_t *e = lookup_var((char *)&n);
+    var_entry_t *e = lookup_own_var((char *)&n);
     if (e == NULL) {
         return NULL;
     }
+    save_slot((size_t)(e - calc_env->vars));
     NAME_AS_INT(e->name) = NAME_AS_INT(name);
     e->fundef = NULL;
+    STAT_POOL(STAT_POOL_VARS, e - calc_env->vars + 1, CALC_VAR_SIZE);
     return e;
 }
 
+// Returns the slot of name in the environment itself, creating it if
+// needed.  A slot that shadows a name of the base makes all bindings dirty,
+// as their formulas may have read the base.
 var_entry_t *get_or_create_var(const char *name) {
-    var_entry_t *e = lookup_var(name);
+    var_entry_t *e = lookup_own_var(name);
     if (e == NULL) {
         e = create_var(name);
+        if (e != NULL && lookup_base_var(name) != NULL) {
+            code_stale = 1;
+            for (size_t i = 0; i < CALC_VAR_SIZE; i++) {
+                if (calc_env->formulas[i] != NULL) {
+                    save_slot(i);
+                    calc_env->var_flags[i] |= VAR_DIRTY;
+                }
+            }
+        }
+    } else {
+        save_slot((size_t)(e - calc_env->vars));
     }
     return e;
 }
 
-#define CALC_FUNDEF_BUFSIZE 2048
-static char fundefs[CALC_FUNDEF_BUFSIZE];
-static char *fundefs_p = fundefs;
+static void invalidate_dependents(size_t v) {
+    calc_env_t *env = calc_env;
+    for (size_t i = 0; i < CALC_VAR_SIZE; i++) {
+        if ((env->deps[i][v / 32] >> (v % 32) & 1) != 0 &&
+            (env->var_flags[i] & VAR_DIRTY) == 0) {
+            save_slot(i);
+            env->var_flags[i] |= VAR_DIRTY;
+            invalidate_dependents(i);
+        }
+    }
+}
+
+static void unbind_var(size_t v) {
+    calc_env_t *env = calc_env;
+    save_slot(v);
+    env->formulas[v] = NULL;
+    env->var_flags[v] = 0;
+    for (size_t w = 0; w < DEPS_WORDS; w++) {
+        env->deps[v][w] = 0;
+    }
+}
+
+// Evaluates the formula of binding v, already parsed into body.
+static int eval_binding(size_t v, const symb_t *body) {
+    calc_env_t *env = calc_env;
+    if (env->var_flags[v] & VAR_BUSY) CALC_DIE("circular binding");
+    save_slot(v);
+    for (size_t w = 0; w < DEPS_WORDS; w++) {
+        env->deps[v][w] = 0;
+    }
+    size_t saved = env->cur_binding;
+    env->cur_binding = v;
+    env->var_flags[v] |= VAR_BUSY;
+    int ret = do_eval(&env->vars[v].val, body);
+    env->var_flags[v] &= ~VAR_BUSY;
+    env->cur_binding = saved;
+    if (ret == 0) {
+        env->var_flags[v] &= ~VAR_DIRTY;
+    }
+    return ret;
+}
+
+static int recompute_binding(size_t v) {
+    if (calc_env->var_flags[v] & VAR_BUSY) CALC_DIE("circular binding");
+    symb_t *mark = get_slr_mem_mark();
+    const char *str = calc_env->formulas[v];
+    symb_t *body;
+#ifdef MINCALC_SLR_ONLY
+    init_slr_expr();
+    token_t tok;
+    do {
+        if (get_next_tok(&tok, &str) != 0) CALC_DIE("binding lex error");
+        if (slr_feed_token(&tok) != 0) CALC_DIE("binding parse error");
+    } while (tok.type != TOK_EOS);
+    body = slr_get_result();
+#else
+    if (prec_parse_expr(&body, &str) != 0) CALC_DIE("binding parse error");
+#endif
+    if (body == NULL) CALC_DIE("binding parse error");
+    int ret = eval_binding(v, body);
+    release_slr_mem(mark);
+    return ret;
+}
+
+// Called on every read of a global variable or function: records the
+// dependency of the binding being computed and brings e up to date.
+static int use_global(var_entry_t *e) {
+    calc_env_t *env = calc_env;
+    if (in_base(e)) {
+        size_t v = (size_t)(e - env->base->vars);
+        if (env->base->var_flags[v] & VAR_DIRTY)
+            CALC_DIE("binding of base environment out of date");
+        return 0;
+    }
+    size_t v = (size_t)(e - env->vars);
+    if (env->cur_binding != CALC_VAR_SIZE) {
+        env->deps[env->cur_binding][v / 32] |= (uint32_t)1 << (v % 32);
+    }
+    if (env->var_flags[v] & VAR_DIRTY) {
+        return recompute_binding(v);
+    }
+    return 0;
+}
+
+static int update_bindings(calc_env_t *env) {
+    calc_env_t *saved = calc_env;
+    int ret = 0;
+    calc_env = env;
+    for (size_t v = 0; v < CALC_VAR_SIZE && ret == 0; v++) {
+        if (env->var_flags[v] & VAR_DIRTY) {
+            ret = recompute_binding(v);
+        }
+    }
+    calc_env = saved;
+    return ret;
+}
+
+// A frozen environment holds no pointers, so that its bytes can serve as a
+// base at any address, also mapped by another process.  The fundef of a
+// function is 1 + the offset of its definition in fundefs (calc_fundef);
+// formulas, fundefs_p and base are NULL.  env is a copy of an environment
+// whose fundef buffer is at origin.  Its checkpoints are dropped.
+static void drop_pointers(calc_env_t *env, const char *origin) {
+    for (size_t i = 0; i < CALC_VAR_SIZE; i++) {
+        var_entry_t *e = &env->vars[i];
+        if (e->fundef != NULL) {
+            e->fundef = (void *)(uintptr_t)((char *)e->fundef - origin + 1);
+        }
+        env->formulas[i] = NULL;
+    }
+    env->fundefs_p = NULL;
+    env->cur_binding = CALC_VAR_SIZE;
+    env->base = NULL;
+    env->frozen = 1;
+    unsigned char *p = (unsigned char *)env->checkpoints;
+    for (size_t i = 0; i < sizeof(env->checkpoints); i++) {
+        p[i] = 0;
+    }
+    env->ncheckpoints = 0;
+    env->last_checkpoint = 0;
+    env->log = NULL;
+}
+
+// Brings all bindings of env up to date and freezes it, so that it can
+// serve as the base of other environments.  It runs no statements after.
+int calc_env_freeze(calc_env_t *env) {
+    if (env->frozen) {
+        return 0;
+    }
+    if (env->base != NULL) CALC_DIE("environment has a base");
+    if (update_bindings(env) != 0) return 1;
+    drop_pointers(env, env->fundefs);
+    code_stale = 1;
+    return 0;
+}
 
 int do_svar(const symb_t *symb, const char *input) {
+    calc_env_t *env = calc_env;
 #ifndef NDEBUG
     if (symb->type != ~RL_STMT_SETVAR) CALC_DIE("not a statement");
 #endif
@@ -73,7 +442,15 @@ int do_svar(const symb_t *symb, const char *input) {
 #endif
         var_entry_t *e = get_or_create_var(id->token.idname);
         if (e == NULL) CALC_DIE("ran out of variable space");
-        return do_eval(&e->val, symb->arg1->arg2);
+        int val;
+        if (do_eval(&val, symb->arg1->arg2) != 0) return 1;
+        size_t v = (size_t)(e - env->vars);
+        unbind_var(v);
+        if (e->val != val) {
+            e->val = val;
+            invalidate_dependents(v);
+        }
+        return 0;
     }
     if (symb->type == ~RL_SETVAR_FUNDEF) {
 #ifndef NDEBUG
@@ -83,19 +460,58 @@ int do_svar(const symb_t *symb, const char *input) {
 #ifndef NDEBUG
         if (id->token.type != TOK_ID) CALC_DIE("fundef lhs id not an id");
 #endif
+        if (builtin_lookup(id->token.idname) != NULL)
+            CALC_DIE("redefining a built-in function");
         var_entry_t *e = get_or_create_var(id->token.idname);
         if (e == NULL) CALC_DIE("ran out of variable space");
         size_t len = mc_strlen(input);
-        if (fundefs_p + len + 1 > fundefs + CALC_FUNDEF_BUFSIZE) {
+        if (env->fundefs_p + len + 1 > env->fundefs + CALC_FUNDEF_BUFSIZE) {
             CALC_DIE("ran out of fundef buffer");
         }
-        e->fundef = fundefs_p;
-        mc_strcpy(fundefs_p, input);
-        fundefs_p += len + 1;
+        e->fundef = env->fundefs_p;
+        code_stale = 1;
+        mc_strcpy(env->fundefs_p, input);
+        env->fundefs_p += len + 1;
+        STAT_POOL(STAT_POOL_FUNDEF_BYTES, env->fundefs_p - env->fundefs,
+                  CALC_FUNDEF_BUFSIZE);
+        size_t v = (size_t)(e - env->vars);
+        unbind_var(v);
+        invalidate_dependents(v);
         return 0;
     }
+    if (symb->type == ~RL_SETVAR_BIND) {
+#ifndef NDEBUG
+        if (symb->arg1->type != ~RL_BIND) CALC_DIE("not a binding");
+#endif
+        const symb_t *id = symb->arg1->arg1;
+#ifndef NDEBUG
+        if (id->token.type != TOK_ID) CALC_DIE("binding lhs not an id");
+#endif
+        var_entry_t *e = get_or_create_var(id->token.idname);
+        if (e == NULL) CALC_DIE("ran out of variable space");
+        const char *formula = mc_strstr(input, "::=") + 3;
+        size_t len = mc_strlen(formula);
+        if (env->fundefs_p + len + 1 > env->fundefs + CALC_FUNDEF_BUFSIZE) {
+            CALC_DIE("ran out of fundef buffer");
+        }
+        size_t v = (size_t)(e - env->vars);
+        unbind_var(v);
+        if (e->fundef != NULL) {
+            e->fundef = NULL;
+            code_stale = 1;
+        }
+        env->formulas[v] = env->fundefs_p;
+        mc_strcpy(env->fundefs_p, formula);
+        env->fundefs_p += len + 1;
+        STAT_POOL(STAT_POOL_FUNDEF_BYTES, env->fundefs_p - env->fundefs,
+                  CALC_FUNDEF_BUFSIZE);
+        // the binding stays dirty until its formula evaluates successfully
+        env->var_flags[v] = VAR_DIRTY;
+        invalidate_dependents(v);
+        return eval_binding(v, symb->arg1->arg2);
+    }
 #ifndef NDEBUG
-    CALC_DIE("not assign nor fundef");
+    CALC_DIE("not assign, fundef nor binding");
 #endif
     return 1;
 }
@@ -104,10 +520,424 @@ int do_eval(int *result, const symb_t *symb) {
     return do_eval_ctx(result, symb, NULL, 0);
 }
 
+// ======
+// limits
+// ======
+
+// do_eval_ctx already counts the nodes it evaluates in mc_stats.nodes.  When
+// the count reaches check_at, check_limits checks the limits of the
+// statement and sets the next check point, at most LIMIT_CHUNK nodes on, so
+// a node costs one more compare, and the clock and the interrupt flag are
+// only looked at every LIMIT_CHUNK nodes.  Once a limit has been hit every
+// node is checked and fails, until the next statement starts.  An error
+// unwinds the evaluation like any other, so variables keep the values they
+// had before the statement.
+
+#define LIMIT_CHUNK 4096
+#define NO_LIMIT ((unsigned long)-1)
+
+static unsigned long check_at = LIMIT_CHUNK;
+static unsigned long nodes_left = NO_LIMIT;  // after check_at
+static const char *stopped;                  // why, once a limit is hit
+
+#ifndef __FPGA_EXP__
+static volatile sig_atomic_t interrupted;
+static uint64_t deadline_ns;  // 0 if none
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void calc_interrupt(void) { interrupted = 1; }
+#endif
+
+// Counts are compared for equality, so they may wrap around.
+static void next_check(void) {
+    unsigned long n = nodes_left < LIMIT_CHUNK ? nodes_left : LIMIT_CHUNK;
+    nodes_left -= n;
+    check_at = mc_stats.nodes + n;
+}
+
+static int check_limits(void) {
+    if (stopped == NULL) {
+#ifndef __FPGA_EXP__
+        if (interrupted) {
+            stopped = "interrupted";
+        } else if (deadline_ns != 0 && now_ns() >= deadline_ns) {
+            stopped = "time limit exceeded";
+        }
+#endif
+        if (stopped == NULL && nodes_left == 0) {
+            stopped = "node limit exceeded";
+        }
+    }
+    if (stopped != NULL) {
+        check_at = mc_stats.nodes + 1;
+        CALC_DIE(stopped);
+    }
+    next_check();
+    return 0;
+}
+
+void calc_start_statement(const calc_limits_t *limits) {
+    // the node after the last one allowed is the one that finds none left
+    nodes_left = limits->nodes != 0 && limits->nodes != NO_LIMIT
+                     ? limits->nodes + 1
+                     : NO_LIMIT;
+    stopped = NULL;
+#ifndef __FPGA_EXP__
+    interrupted = 0;
+    deadline_ns = limits->ms != 0 ? now_ns() + limits->ms * 1000000u : 0;
+#endif
+    next_check();
+}
+
+// =========
+// arguments
+// =========
+
+// In the eager mode, the default, the arguments of a call are evaluated from
+// left to right before the body, and the first error stops the call even if
+// the body would not have used that argument.
+//
+// In the lazy mode (call by need) a parameter is bound to a thunk: the
+// argument and the scope of the caller.  It is evaluated on its first use,
+// and its value is then kept in the frame and the thunk.  An argument that
+// is never used is never evaluated, so its errors are not reported, and the
+// errors of the others are reported in the order of use.  While a parameter
+// is unevaluated its entry's fundef points to the thunk; no entry of a
+// scope or frame holds a function otherwise.  Literals are bound directly,
+// and an unevaluated parameter passed on as it is shares its thunk.
+//
+// Thunks live in the frame of the call they were made for, and only point
+// into the scopes of callers, which outlive it.
+
+typedef struct {
+    const symb_t *expr;  // NULL once evaluated
+    var_entry_t *ctx;
+    size_t ctx_size;
+    int val;
+} thunk_t;
+
+static int force(int *result, var_entry_t *e) {
+    thunk_t *t = e->fundef;
+    if (t->expr != NULL) {
+        if (do_eval_ctx(&t->val, t->expr, t->ctx, t->ctx_size) != 0) {
+            return 1;
+        }
+        t->expr = NULL;
+    }
+    e->fundef = NULL;
+    *result = e->val = t->val;
+    return 0;
+}
+
+static size_t count_args(const symb_t *arglist_opt) {
+    if (arglist_opt->type != ~RL_ARGLIST_OPT_1) {
+        return 0;
+    }
+    size_t n = 1;
+    const symb_t *arg = arglist_opt->arg1;
+    for (; arg->type == ~RL_ARGLIST_CONS; arg = arg->arg2) {
+        n++;
+    }
+    return n;
+}
+
+static int eval_args(var_entry_t *slots, const symb_t *arglist_opt,
+                     var_entry_t *ctx, size_t ctx_size) {
+    if (arglist_opt->type != ~RL_ARGLIST_OPT_1) {
+        return 0;
+    }
+    const symb_t *arg = arglist_opt->arg1;
+    for (size_t i = 0;; i++) {
+        if (do_eval_ctx(&slots[i].val, arg->arg1, ctx, ctx_size) != 0) {
+            return 1;
+        }
+        if (arg->type != ~RL_ARGLIST_CONS) {
+            return 0;
+        }
+        arg = arg->arg2;
+    }
+}
+
+static void bind_args(var_entry_t *slots, thunk_t *thunks,
+                      const symb_t *arglist_opt, var_entry_t *ctx,
+                      size_t ctx_size) {
+    if (arglist_opt->type != ~RL_ARGLIST_OPT_1) {
+        return;
+    }
+    const symb_t *arg = arglist_opt->arg1;
+    for (size_t i = 0;; i++) {
+        const symb_t *a = arg->arg1;
+        if (a->type == ~RL_TERM_INT) {
+            a = a->arg1;
+        }
+        if (a->type == TOK_NUM) {
+            slots[i].val = a->token.num;
+            slots[i].fundef = NULL;
+        } else if (a->type == NODE_ARG) {
+            slots[i] = ctx[a->frame.slot];
+        } else {
+            thunks[i].expr = a;
+            thunks[i].ctx = ctx;
+            thunks[i].ctx_size = ctx_size;
+            slots[i].fundef = &thunks[i];
+        }
+        if (arg->type != ~RL_ARGLIST_CONS) {
+            return;
+        }
+        arg = arg->arg2;
+    }
+}
+
+// Evaluates body on a frame whose first slots take the arguments of a call
+// made in ctx, in the lazy mode.  The thunks are kept here for the call; in
+// the eager mode callers run eval_args and the body themselves, so that the
+// common case is not slowed down by them.
+static int eval_lazy_call(int *result, const symb_t *body, var_entry_t *frame,
+                          size_t frame_size, const symb_t *arglist_opt,
+                          var_entry_t *ctx, size_t ctx_size) {
+    size_t nargs = count_args(arglist_opt);
+    thunk_t thunks[nargs > 0 ? nargs : 1];
+    bind_args(frame, thunks, arglist_opt, ctx, ctx_size);
+    return do_eval_ctx(result, body, frame, frame_size);
+}
+
+// ==========
+// reductions
+// ==========
+
+// sum(i, lo, hi, expr), prod(i, lo, hi, expr) and fold(i, lo, hi, a, init,
+// expr) evaluate expr for i = lo ... hi in a loop, in a scope set up once
+// that binds i, and for fold the accumulator a, in front of the caller's.
+// In compiled function bodies the bound variables are slots of the frame
+// instead.  A sum whose body does not mention i evaluates it once and
+// multiplies it by the number of terms.  A sum of more than one term whose
+// body is affine in i, c*i + d with c and d independent of i, is computed in
+// closed form from the body at i = lo and i = lo + 1, so that it is only
+// evaluated where the loop would; as the arithmetic wraps around, the result
+// is the one of the loop.
+//
+// Subtrees shared by CSE may depend on the bound variables, so the epoch is
+// advanced whenever their values change.
+
+#define REDUCE_MAX_ARGS 6
+
+// Returns the node of a bound variable argument: a NODE_SLOT or a TOK_ID.
+static const symb_t *bound_var(const symb_t *arg) {
+    while (arg->type == NODE_SHARED || arg->type == ~RL_TERM_ID) {
+        arg = arg->type == NODE_SHARED ? arg->shared.body : arg->arg1;
+    }
+    return arg;
+}
+
+static int mentions(const symb_t *node, const symb_t *var) {
+    switch (node->type) {
+        case NODE_SHARED:
+            return mentions(node->shared.body, var);
+        case NODE_SLOT:
+            return var->type == NODE_SLOT &&
+                   node->frame.slot == var->frame.slot;
+        case NODE_ARG:
+        case NODE_GLOBAL:
+            return 0;
+        case NODE_INLINE:
+            // the body of the callee only sees its own slots
+            return mentions(node->frame.args, var);
+        case TOK_ID:
+            return var->type == TOK_ID && NAME_AS_INT(node->token.idname) ==
+                                              NAME_AS_INT(var->token.idname);
+        default:
+            break;
+    }
+    if (node->type >= 0) {
+        return 0;
+    }
+    int nargs = slr_rule_nargs(~node->type);
+    return (nargs >= 1 && mentions(node->arg1, var)) ||
+           (nargs >= 2 && mentions(node->arg2, var)) ||
+           (nargs >= 3 && mentions(node->arg3, var));
+}
+
+static int is_affine(const symb_t *node, const symb_t *var) {
+    if (!mentions(node, var) || node->type == TOK_ID ||
+        node->type == NODE_SLOT) {
+        return 1;
+    }
+    if (node->type == NODE_SHARED) {
+        return is_affine(node->shared.body, var);
+    }
+    switch (~node->type) {
+        case RL_ADD:
+        case RL_SUB:
+            return is_affine(node->arg1, var) && is_affine(node->arg2, var);
+        case RL_MUL:
+            return (!mentions(node->arg1, var) &&
+                    is_affine(node->arg2, var)) ||
+                   (!mentions(node->arg2, var) && is_affine(node->arg1, var));
+        case RL_UPLUS:
+        case RL_UMINUS:
+        case RL_TERM_ID:
+        case RL_TERM_GROUP:
+            return is_affine(node->arg1, var);
+        default:
+            return 0;
+    }
+}
+
+// Returns 0 + 1 + ... + m = m (m + 1) / 2 modulo 2^32, halving the even
+// factor.
+static uint32_t range_sum(uint32_t m) {
+    return (m & 1) != 0 ? (uint32_t)ARITH_MUL(m, (m >> 1) + 1)
+                        : (uint32_t)ARITH_MUL(m >> 1, m + 1);
+}
+
+static int reduce(int *result, const builtin_t *b, const symb_t *arglist_opt,
+                  var_entry_t *ctx, size_t ctx_size) {
+    const symb_t *args[REDUCE_MAX_ARGS];
+    const symb_t *arg = arglist_opt->arg1;
+    for (int i = 0; i < b->nargs; i++) {
+        if (i > 0) {
+            arg = arg->arg2;
+        }
+        args[i] = arg->arg1;
+    }
+    int lo, hi;
+    uint32_t acc = b->form == BUILTIN_PROD;
+    if (do_eval_ctx(&lo, args[1], ctx, ctx_size) != 0 ||
+        do_eval_ctx(&hi, args[2], ctx, ctx_size) != 0) {
+        return 1;
+    }
+    if (b->form == BUILTIN_FOLD) {
+        int init;
+        if (do_eval_ctx(&init, args[4], ctx, ctx_size) != 0) return 1;
+        acc = (uint32_t)init;
+    }
+    if (lo > hi) {
+        *result = (int)acc;
+        return 0;
+    }
+
+    const symb_t *ivar = bound_var(args[0]);
+    int compiled = ivar->type == NODE_SLOT;
+    size_t nbound = b->form == BUILTIN_FOLD ? 2 : 1;
+    var_entry_t named[compiled ? 1 : nbound + ctx_size];
+    var_entry_t *scope = named;
+    size_t scope_size = nbound + ctx_size;
+    var_entry_t *iv = &named[0];
+    var_entry_t *av = &named[1];
+    if (compiled) {
+        scope = ctx;
+        scope_size = ctx_size;
+        iv = &ctx[ivar->frame.slot];
+        if (b->form == BUILTIN_FOLD) {
+            av = &ctx[bound_var(args[3])->frame.slot];
+        }
+    } else {
+        NAME_AS_INT(named[0].name) = NAME_AS_INT(ivar->token.idname);
+        named[0].fundef = NULL;
+        if (b->form == BUILTIN_FOLD) {
+            NAME_AS_INT(named[1].name) =
+                NAME_AS_INT(bound_var(args[3])->token.idname);
+            named[1].fundef = NULL;
+        }
+        for (size_t i = 0; i < ctx_size; i++) {
+            named[nbound + i] = ctx[i];
+        }
+    }
+    const symb_t *body = args[b->nargs - 1];
+    uint32_t m = (uint32_t)hi - (uint32_t)lo;  // iterations - 1
+
+    if (b->form == BUILTIN_SUM && !mentions(body, ivar)) {
+        int f;
+        iv->val = lo;
+        cse_epoch++;
+        if (do_eval_ctx(&f, body, scope, scope_size) != 0) return 1;
+        cse_epoch++;
+        *result = (int)(uint32_t)ARITH_MUL((uint32_t)f, m + 1);
+        return 0;
+    }
+    if (b->form == BUILTIN_SUM && m >= 1 && is_affine(body, ivar)) {
+        // f(lo + k) = f0 + c k for k = 0 ... m
+        int f0, f1;
+        iv->val = lo;
+        cse_epoch++;
+        if (do_eval_ctx(&f0, body, scope, scope_size) != 0) return 1;
+        iv->val = (int)((uint32_t)lo + 1);
+        cse_epoch++;
+        if (do_eval_ctx(&f1, body, scope, scope_size) != 0) return 1;
+        cse_epoch++;
+        uint32_t c = (uint32_t)f1 - (uint32_t)f0;
+        *result = (int)((uint32_t)ARITH_MUL(c, range_sum(m)) +
+                        (uint32_t)ARITH_MUL((uint32_t)f0, m + 1));
+        return 0;
+    }
+
+    for (uint32_t k = 0;; k++) {
+        int val;
+        iv->val = (int)((uint32_t)lo + k);
+        if (b->form == BUILTIN_FOLD) {
+            av->val = (int)acc;
+        }
+        cse_epoch++;
+        if (do_eval_ctx(&val, body, scope, scope_size) != 0) return 1;
+        switch (b->form) {
+            case BUILTIN_SUM:
+                acc += (uint32_t)val;
+                break;
+            case BUILTIN_PROD:
+                acc = (uint32_t)ARITH_MUL(acc, (uint32_t)val);
+                break;
+            default:
+                acc = (uint32_t)val;
+                break;
+        }
+        if (k == m) {
+            break;
+        }
+    }
+    cse_epoch++;
+    *result = (int)acc;
+    return 0;
+}
+
+// The arguments were checked by the parser.
+static int call_builtin(int *result, const builtin_t *b,
+                        const symb_t *arglist_opt, var_entry_t *ctx,
+                        size_t ctx_size) {
+    if (b->form != BUILTIN_NATIVE) {
+        return reduce(result, b, arglist_opt, ctx, ctx_size);
+    }
+    int args[BUILTIN_MAX_ARGS];
+    if (arglist_opt->type == ~RL_ARGLIST_OPT_1) {
+        const symb_t *arg = arglist_opt->arg1;
+        for (int i = 0; i < b->nargs; i++) {
+            if (i > 0) {
+                arg = arg->arg2;
+            }
+            if (do_eval_ctx(&args[i], arg->arg1, ctx, ctx_size) != 0)
+                return 1;
+        }
+    }
+    return b->fn(result, args);
+}
+
+static int call_user(int *result, var_entry_t *e, const symb_t *arglist_opt,
+                     var_entry_t *ctx, size_t ctx_size);
+static int call_inline(int *result, const symb_t *call, var_entry_t *ctx,
+                       size_t ctx_size);
+
 int do_eval_ctx(int *result, const symb_t *symb, var_entry_t *ctx,
                 size_t ctx_size) {
     int arg1, arg2;
     if (symb == NULL) CALC_DIE("internal error");
+    STAT_INC(nodes);
+    PROF_NODE();
+    UART_POLL(mc_stats.nodes);
+    if (mc_stats.nodes == check_at && check_limits() != 0) return 1;
     switch (symb->type) {
         case TOK_NUM:
             *result = symb->token.num;
@@ -117,9 +947,12 @@ int do_eval_ctx(int *result, const symb_t *symb, var_entry_t *ctx,
             e = lookup_var_ctx(symb->token.idname, ctx, ctx_size);
             if (e == NULL) {
                 e = lookup_var(symb->token.idname);
+                if (e == NULL) CALC_DIE("undefined variable");
+                if (use_global(e) != 0) return 1;
+                if (e->fundef != NULL) CALC_DIE("using function as a number");
+            } else if (e->fundef != NULL) {
+                return force(result, e);
             }
-            if (e == NULL) CALC_DIE("undefined variable");
-            if (e->fundef != NULL) CALC_DIE("using function as a number");
             *result = e->val;
             return 0;
         }
@@ -226,21 +1059,26 @@ int do_eval_ctx(int *result, const symb_t *symb, var_entry_t *ctx,
                 do_eval_ctx(&arg2, symb->arg2, ctx, ctx_size) != 0) {
                 return 1;
             }
-            *result = arg1 * arg2;
+            *result = ARITH_MUL(arg1, arg2);
             return 0;
         case ~RL_DIV:
             if (do_eval_ctx(&arg1, symb->arg1, ctx, ctx_size) != 0 ||
                 do_eval_ctx(&arg2, symb->arg2, ctx, ctx_size) != 0) {
                 return 1;
             }
-            *result = arg1 / arg2;
+            if (arg2 == 0) CALC_DIE("division by zero");
+            // INT_MIN / -1 wraps like the other operators instead of trapping
+            *result =
+                arg2 == -1 ? (int)(0u - (unsigned int)arg1)
+                           : ARITH_DIV(arg1, arg2);
             return 0;
         case ~RL_MOD:
             if (do_eval_ctx(&arg1, symb->arg1, ctx, ctx_size) != 0 ||
                 do_eval_ctx(&arg2, symb->arg2, ctx, ctx_size) != 0) {
                 return 1;
             }
-            *result = arg1 % arg2;
+            if (arg2 == 0) CALC_DIE("division by zero");
+            *result = arg2 == -1 ? 0 : ARITH_MOD(arg1, arg2);
             return 0;
         case ~RL_NOT:
             if (do_eval_ctx(&arg1, symb->arg1, ctx, ctx_size) != 0) {
@@ -261,24 +1099,59 @@ int do_eval_ctx(int *result, const symb_t *symb, var_entry_t *ctx,
             if (symb->arg1->token.type != TOK_ID)
                 CALC_DIE("funcall id not an id");
 #endif
+            const builtin_t *b = builtin_lookup(symb->arg1->token.idname);
+            if (b != NULL) {
+                return call_builtin(result, b, symb->arg2, ctx, ctx_size);
+            }
             var_entry_t *e = lookup_var(symb->arg1->token.idname);
             if (e == NULL) CALC_DIE("undefined function");
+            if (use_global(e) != 0) return 1;
             if (e->fundef == NULL) CALC_DIE("using number as function");
-            return call_function(result, e->fundef, symb->arg2, ctx, ctx_size);
+            if (call_depth == CALC_CALL_DEPTH) CALC_DIE("recursion too deep");
+            STAT_INC(calls);
+            PROF_ENTER(e->name);
+            call_depth++;
+            int ret = call_user(result, e, symb->arg2, ctx, ctx_size);
+            call_depth--;
+            PROF_EXIT();
+            return ret;
+        }
+        case NODE_SLOT:
+            *result = ctx[symb->frame.slot].val;
+            return 0;
+        case NODE_ARG: {
+            var_entry_t *e = &ctx[symb->frame.slot];
+            if (e->fundef != NULL) {
+                return force(result, e);
+            }
+            *result = e->val;
+            return 0;
+        }
+        case NODE_GLOBAL: {
+            var_entry_t *e = lookup_var(symb->token.idname);
+            if (e == NULL) CALC_DIE("undefined variable");
+            if (use_global(e) != 0) return 1;
+            if (e->fundef != NULL) CALC_DIE("using function as a number");
+            *result = e->val;
+            return 0;
+        }
+        case NODE_INLINE:
+            return call_inline(result, symb, ctx, ctx_size);
+        case NODE_SHARED: {
+            symb_t *shared = (symb_t *)(uintptr_t)symb;
+            if (shared->shared.epoch != cse_epoch) {
+                if (do_eval_ctx(&shared->shared.val, shared->shared.body, ctx,
+                                ctx_size) != 0) {
+                    return 1;
+                }
+                shared->shared.epoch = cse_epoch;
+            }
+            *result = shared->shared.val;
+            return 0;
         }
         case ~RL_STMT_EXPR:
-        case ~RL_EXPR_OR:
-        case ~RL_EXPR_XOR:
-        case ~RL_EXPR_AND:
-        case ~RL_EXPR_EQ:
-        case ~RL_EXPR_CMP:
-        case ~RL_EXPR_SHIFT:
-        case ~RL_EXPR_ADDSUB:
-        case ~RL_EXPR_MULDIV:
-        case ~RL_EXPR_UNARY:
         case ~RL_TERM_INT:
         case ~RL_TERM_ID:
-        case ~RL_TERM_FUNCALL:
         case ~RL_TERM_GROUP:
             return do_eval_ctx(result, symb->arg1, ctx, ctx_size);
         default:
@@ -286,24 +1159,9 @@ int do_eval_ctx(int *result, const symb_t *symb, var_entry_t *ctx,
     }
 }
 
-int call_function(int *result, const char *fundef_str, symb_t *arglist_opt,
-                  var_entry_t *ctx, size_t ctx_size) {
-    size_t argc;
-    if (arglist_opt->type == ~RL_ARGLIST_OPT_0) {
-        argc = 0;
-    } else if (arglist_opt->type == ~RL_ARGLIST_OPT_1) {
-        argc = 1;
-        symb_t *arg = arglist_opt->arg1;
-        while (arg->type == ~RL_ARGLIST_CONS) {
-            arg = arg->arg2;
-            argc++;
-        }
-#ifndef NDEBUG
-        if (arg->type != ~RL_ARGLIST) CALC_DIE("malformed arglist");
-#endif
-    } else
-        CALC_DIE("arglist_opt not an arglist_opt");
-
+int parse_fundef(symb_t **body, size_t *nparams, var_entry_t *scope,
+                 size_t max_params, const char *fundef_str) {
+#ifdef MINCALC_SLR_ONLY
     init_slr_svar();
     token_t tok;
     do {
@@ -321,47 +1179,840 @@ int call_function(int *result, const char *fundef_str, symb_t *arglist_opt,
         CALC_DIE("function definition error 3");
 #endif
     symb_t *idlist_opt = fundef->arg1->arg1->arg2;
-    size_t req_argc;
-    if (idlist_opt->type == ~RL_IDLIST_OPT_0) {
-        req_argc = 0;
-    } else if (idlist_opt->type == ~RL_IDLIST_OPT_1) {
-        req_argc = 1;
+    size_t n = 0;
+    if (idlist_opt->type == ~RL_IDLIST_OPT_1) {
         symb_t *id = idlist_opt->arg1;
-        while (id->type == ~RL_IDLIST_CONS) {
+        while (1) {
+#ifndef NDEBUG
+            if (id->arg1->token.type != TOK_ID) CALC_DIE("idlist id not id");
+#endif
+            if (n < max_params) {
+                NAME_AS_INT(scope[n].name) =
+                    NAME_AS_INT(id->arg1->token.idname);
+            }
+            n++;
+            if (id->type != ~RL_IDLIST_CONS) {
+                break;
+            }
             id = id->arg2;
-            req_argc++;
         }
 #ifndef NDEBUG
         if (id->type != ~RL_IDLIST) CALC_DIE("malformed idlist");
 #endif
-    } else
+    } else if (idlist_opt->type != ~RL_IDLIST_OPT_0)
         CALC_DIE("idlist_opt not an idlist_opt");
+    *nparams = n;
+    *body = fundef->arg1->arg1->arg3;
+    return 0;
+#else
+    // the definition was checked by the SLR parser in do_svar, so the
+    // parameter list is read directly off the tokens and only the body is
+    // parsed
+    token_t tok;
+    if (get_next_tok(&tok, &fundef_str) != 0 ||  // name
+        get_next_tok(&tok, &fundef_str) != 0 ||  // (
+        get_next_tok(&tok, &fundef_str) != 0)
+        CALC_DIE("function lex error");
+    size_t n = 0;
+    while (tok.type == TOK_ID) {
+        if (n < max_params) {
+            NAME_AS_INT(scope[n].name) = NAME_AS_INT(tok.idname);
+        }
+        n++;
+        if (get_next_tok(&tok, &fundef_str) != 0)
+            CALC_DIE("function lex error");
+        if (tok.type == TOK_COMMA && get_next_tok(&tok, &fundef_str) != 0)
+            CALC_DIE("function lex error");
+    }
+#ifndef NDEBUG
+    if (tok.type != TOK_RPAR) CALC_DIE("function definition error");
+#endif
+    if (get_next_tok(&tok, &fundef_str) != 0)  // :=
+        CALC_DIE("function lex error");
+    if (prec_parse_expr(body, &fundef_str) != 0 || *body == NULL)
+        CALC_DIE("function parse error");
+    *nparams = n;
+    return 0;
+#endif
+}
 
+// Binds the argc arguments of a call to the parameters of fundef_str and
+// evaluates its body.
+static int call_body(int *result, const char *fundef_str, size_t argc,
+                     const symb_t *arglist_opt, var_entry_t *ctx,
+                     size_t ctx_size) {
+    var_entry_t scope[argc];
+    symb_t *body;
+    size_t req_argc;
+    if (parse_fundef(&body, &req_argc, scope, argc, fundef_str) != 0) return 1;
     if (argc != req_argc) CALC_DIE("wrong number of arguments");
+    for (size_t i = 0; i < argc; i++) {
+        scope[i].fundef = NULL;
+    }
+    if (calc_args == CALC_ARGS_LAZY) {
+        return eval_lazy_call(result, body, scope, argc, arglist_opt, ctx,
+                              ctx_size);
+    }
+    if (eval_args(scope, arglist_opt, ctx, ctx_size) != 0) {
+        return 1;
+    }
+    return do_eval_ctx(result, body, scope, argc);
+}
 
-    var_entry_t scope[argc];
-    if (argc != 0) {
-        int i = 0;
-        symb_t *arg = arglist_opt->arg1;
-        symb_t *id = idlist_opt->arg1;
+int call_function(int *result, const char *fundef_str,
+                  const symb_t *arglist_opt, var_entry_t *ctx,
+                  size_t ctx_size) {
+    size_t argc;
+    if (arglist_opt->type == ~RL_ARGLIST_OPT_0) {
+        argc = 0;
+    } else if (arglist_opt->type == ~RL_ARGLIST_OPT_1) {
+        argc = 1;
+        const symb_t *arg = arglist_opt->arg1;
         while (arg->type == ~RL_ARGLIST_CONS) {
-#ifndef NDEBUG
-            if (id->arg1->token.type != TOK_ID) CALC_DIE("idlist id not id");
-#endif
-            NAME_AS_INT(scope[i].name) = NAME_AS_INT(id->arg1->token.idname);
-            if (do_eval_ctx(&scope[i].val, arg->arg1, ctx, ctx_size) != 0)
-                return 1;
-            scope[i].fundef = NULL;
-            i++;
             arg = arg->arg2;
-            id = id->arg2;
+            argc++;
         }
 #ifndef NDEBUG
-        if (id->arg1->token.type != TOK_ID) CALC_DIE("idlist id not id 2");
+        if (arg->type != ~RL_ARGLIST) CALC_DIE("malformed arglist");
 #endif
-        NAME_AS_INT(scope[i].name) = NAME_AS_INT(id->arg1->token.idname);
-        if (do_eval_ctx(&scope[i].val, arg->arg1, ctx, ctx_size) != 0) return 1;
-        scope[i].fundef = NULL;
+    } else
+        CALC_DIE("arglist_opt not an arglist_opt");
+
+    // the body only lives for this call; its nodes are released afterwards
+    symb_t *mark = get_slr_mem_mark();
+    int ret = call_body(result, fundef_str, argc, arglist_opt, ctx, ctx_size);
+    release_slr_mem(mark);
+    return ret;
+}
+
+// ==================
+// compiled functions
+// ==================
+
+// A function is parsed once, on its first call, and compiled into a body
+// kept in a pool of its own.  Its parameters and the variables bound by its
+// reductions become slots of a frame (NODE_SLOT) allocated once per call,
+// the other names are globals (NODE_GLOBAL), and unit-chain nodes are
+// dropped.
+//
+// A call of a small function that is not itself being compiled, which rules
+// out recursion, is inlined (NODE_INLINE): the callee's frame is placed in
+// the caller's after the slots in use, the arguments are evaluated into it
+// and the callee's compiled body is evaluated on it, without a lookup, a
+// frame of its own or an argument count.
+//
+// Calls are resolved when the caller is compiled, so all bodies are dropped
+// after a function is defined or a name changes meaning, and compiled again
+// on their next call; the semantics stay those of parsing each call.  The
+// cache serves one environment at a time.  A function whose body does not
+// fit is called through call_function.
+//
+// Operators whose operands are all constants are folded while compiling,
+// except for a division by zero, which is left to report its error when it
+// is evaluated.  A function is also specialized on the literal arguments of
+// its calls: once it has been called SPEC_MIN_CALLS times with the same
+// constants in the same leading parameters, a body with these parameters
+// replaced by the constants and folded is compiled and cached next to the
+// generic one.  The constant arguments of a call site count as a call each
+// time a body containing it is compiled, so that a smaller body is more
+// often ready to be inlined; a recursive function whose arguments fold to
+// new constants at each level would otherwise be specialized without end,
+// whether or not the calls are ever made.  For the same reason no more than
+// SPEC_MAX_NEST specializations are compiled one within another.
+// Specialized bodies are dropped with the others.
+//
+// A callee compiled while its caller is being compiled is parsed while the
+// caller's tree is still held, so it is only compiled if the parser memory
+// left is sure to hold its tree; otherwise, as when the code table is full,
+// the call is left to be made at run time.
+
+#define INLINE_MAX_NODES 32
+#define SPEC_MIN_CALLS 2
+#define SPEC_MAX_NEST 2
+
+enum code_state {
+    CODE_COUNTING,  // specialization not compiled yet
+    CODE_COMPILING,
+    CODE_DONE,
+    CODE_FAILED,  // no room; retried after the next flush
+};
+
+// bit k of mask set: parameter k is the constant vals[k]
+typedef struct {
+    unsigned int mask;
+    int vals[CALC_SPEC_PARAMS];
+} spec_t;
+
+static const spec_t no_spec;
+
+typedef struct {
+    const var_entry_t *var;
+    spec_t spec;
+    unsigned int hits;  // calls counted while CODE_COUNTING
+    enum code_state state;
+    symb_t *body;
+    size_t nparams;
+    size_t frame_size;
+    size_t nnodes;  // of the body itself, inlined bodies not counted
+} code_entry_t;
+
+static symb_t code_mem[CALC_CODE_SIZE];
+static symb_t *code_p = code_mem;
+static code_entry_t code_funcs[CALC_CODE_FUNCS];
+static size_t code_nfuncs;
+static const calc_env_t *code_env;  // the environment compiled for
+static int code_full;               // flush as soon as possible
+static int code_active;             // calls of compiled bodies running
+static int code_spec_nest;          // specializations being compiled
+
+typedef struct {
+    const spec_t *spec;
+    size_t nparams;
+    size_t nslots;
+    size_t nnodes;
+    // names in scope, innermost last, and their slots
+    size_t nnames;
+    const char *names[CALC_FRAME_MAX];
+    int slots[CALC_FRAME_MAX];
+    int full;   // out of code space or frame slots
+    int error;  // reported while compiling a callee
+} compiler_t;
+
+static void code_flush(void) {
+    code_p = code_mem;
+    code_nfuncs = 0;
+    code_env = calc_env;
+    code_stale = 0;
+    code_full = 0;
+}
+
+static symb_t *code_node(compiler_t *cp, const symb_t *node) {
+    if (code_p == code_mem + CALC_CODE_SIZE) {
+        code_full = 1;
+        cp->full = 1;
+        return NULL;
+    }
+    cp->nnodes++;
+    *code_p = *node;
+    return code_p++;
+}
+
+static symb_t *slot_node(compiler_t *cp, const symb_t *node, int slot) {
+    symb_t *n = code_node(cp, node);
+    if (n != NULL) {
+        n->frame.type = NODE_SLOT;
+        n->frame.slot = slot;
+    }
+    return n;
+}
+
+static int alloc_slots(compiler_t *cp, size_t n) {
+    if (cp->nslots + n > CALC_FRAME_MAX) {
+        cp->full = 1;
+        return -1;
+    }
+    cp->nslots += n;
+    return (int)(cp->nslots - n);
+}
+
+// Sets spec to the literal arguments among the leading parameters of a call
+// and returns its mask.
+static unsigned int const_args(spec_t *spec, const symb_t *arglist_opt) {
+    spec->mask = 0;
+    if (arglist_opt->type != ~RL_ARGLIST_OPT_1) {
+        return 0;
+    }
+    const symb_t *arg = arglist_opt->arg1;
+    for (int k = 0; k < CALC_SPEC_PARAMS; k++) {
+        const symb_t *a = arg->arg1;
+        if (a->type == ~RL_TERM_INT) {
+            a = a->arg1;
+        }
+        if (a->type == TOK_NUM) {
+            spec->mask |= 1u << k;
+            spec->vals[k] = a->token.num;
+        }
+        if (arg->type != ~RL_ARGLIST_CONS) {
+            break;
+        }
+        arg = arg->arg2;
+    }
+    return spec->mask;
+}
+
+static int get_code(code_entry_t **code, var_entry_t *e, const spec_t *spec,
+                    unsigned int min_calls);
+static symb_t *compile(compiler_t *cp, const symb_t *node);
+
+// Bound variables get slots; lo, hi and init are compiled in the enclosing
+// scope and only the body sees the bound names.
+static symb_t *compile_reduction(compiler_t *cp, const symb_t *call,
+                                 const builtin_t *b) {
+    const symb_t *arg = call->arg2->arg1;
+    const char *iname = bound_var(arg->arg1)->token.idname;
+    const char *aname = NULL;
+    int islot = alloc_slots(cp, b->form == BUILTIN_FOLD ? 2 : 1);
+    if (islot < 0) return NULL;
+    symb_t *n = code_node(cp, call);
+    if (n == NULL || (n->arg1 = code_node(cp, call->arg1)) == NULL ||
+        (n->arg2 = code_node(cp, call->arg2)) == NULL ||
+        (n->arg3 = code_node(cp, call->arg3)) == NULL) {
+        return NULL;
+    }
+    symb_t **link = &n->arg2->arg1;
+    for (int k = 0; k < b->nargs; k++) {
+        if (k > 0) {
+            arg = arg->arg2;
+        }
+        symb_t *cell = code_node(cp, arg);
+        if (cell == NULL) return NULL;
+        *link = cell;
+        link = &cell->arg2;
+        if (k == 0) {
+            cell->arg1 = slot_node(cp, arg->arg1, islot);
+        } else if (k == 3 && b->form == BUILTIN_FOLD) {
+            aname = bound_var(arg->arg1)->token.idname;
+            cell->arg1 = slot_node(cp, arg->arg1, islot + 1);
+        } else if (k < b->nargs - 1) {
+            cell->arg1 = compile(cp, arg->arg1);
+        } else {
+            size_t saved = cp->nnames;
+            if (aname != NULL) {
+                cp->names[cp->nnames] = aname;
+                cp->slots[cp->nnames++] = islot + 1;
+            }
+            cp->names[cp->nnames] = iname;
+            cp->slots[cp->nnames++] = islot;
+            cell->arg1 = compile(cp, arg->arg1);
+            cp->nnames = saved;
+        }
+        if (cell->arg1 == NULL) return NULL;
+    }
+    return n;
+}
+
+static symb_t *compile_call(compiler_t *cp, const symb_t *call) {
+    const builtin_t *b = builtin_lookup(call->arg1->token.idname);
+    if (b != NULL && b->form != BUILTIN_NATIVE) {
+        return compile_reduction(cp, call, b);
+    }
+    symb_t *n = code_node(cp, call);
+    symb_t *args = n != NULL ? compile(cp, call->arg2) : NULL;
+    if (args == NULL) return NULL;
+    var_entry_t *e = NULL;
+    code_entry_t *c = NULL;
+    if (b == NULL && (e = lookup_var(call->arg1->token.idname)) != NULL &&
+        e->fundef != NULL) {
+        spec_t spec;
+        if ((code_spec_nest < SPEC_MAX_NEST && const_args(&spec, args) != 0 &&
+             get_code(&c, e, &spec, SPEC_MIN_CALLS) != 0) ||
+            ((c == NULL || c->state != CODE_DONE) &&
+             get_code(&c, e, &no_spec, 1) != 0)) {
+            cp->error = 1;
+            return NULL;
+        }
+    }
+    if (c != NULL && c->state == CODE_DONE &&
+        c->nnodes <= INLINE_MAX_NODES && count_args(args) == c->nparams &&
+        cp->nslots + c->frame_size <= CALC_FRAME_MAX) {
+        n->frame.type = NODE_INLINE;
+        n->frame.slot = alloc_slots(cp, c->frame_size);
+        n->frame.body = c->body;
+        n->frame.args = args;
+        n->frame.callee = e;
+        return n;
+    }
+    n->arg2 = args;
+    if ((n->arg1 = code_node(cp, call->arg1)) == NULL ||
+        (n->arg3 = code_node(cp, call->arg3)) == NULL) {
+        return NULL;
+    }
+    return n;
+}
+
+// Replaces n, whose operands have just been compiled, by its value if they
+// are all constants, and gives their nodes back.
+static void fold(compiler_t *cp, symb_t *n, int nargs) {
+    if (~n->type < RL_OR || ~n->type > RL_UMINUS ||
+        n->arg1->type != TOK_NUM ||
+        (nargs == 2 && n->arg2->type != TOK_NUM)) {
+        return;
+    }
+    if ((~n->type == RL_DIV || ~n->type == RL_MOD) &&
+        n->arg2->token.num == 0) {
+        return;
+    }
+    int val;
+    if (do_eval_ctx(&val, n, NULL, 0) != 0) {
+        cp->error = 1;  // a limit was hit
+        return;
+    }
+    n->token.type = TOK_NUM;
+    n->token.num = val;
+    if (code_p == n + 1 + nargs) {
+        code_p = n + 1;
+        cp->nnodes -= (size_t)nargs;
+    }
+}
+
+static symb_t *compile(compiler_t *cp, const symb_t *node) {
+    switch (node->type) {
+        case TOK_ID: {
+            for (size_t i = cp->nnames; i-- > 0;) {
+                if (NAME_AS_INT(cp->names[i]) !=
+                    NAME_AS_INT(node->token.idname)) {
+                    continue;
+                }
+                int slot = cp->slots[i];
+                if ((size_t)slot >= cp->nparams || slot >= CALC_SPEC_PARAMS ||
+                    (cp->spec->mask >> slot & 1) == 0) {
+                    symb_t *n = slot_node(cp, node, slot);
+                    if (n != NULL && (size_t)slot < cp->nparams &&
+                        calc_args == CALC_ARGS_LAZY) {
+                        n->type = NODE_ARG;
+                    }
+                    return n;
+                }
+                symb_t *n = code_node(cp, node);
+                if (n != NULL) {
+                    n->token.type = TOK_NUM;
+                    n->token.num = cp->spec->vals[slot];
+                }
+                return n;
+            }
+            symb_t *n = code_node(cp, node);
+            if (n != NULL) {
+                n->type = NODE_GLOBAL;
+            }
+            return n;
+        }
+        case ~RL_TERM_INT:
+        case ~RL_TERM_ID:
+        case ~RL_TERM_GROUP:
+        case ~RL_UPLUS:
+            return compile(cp, node->arg1);
+        case ~RL_FUNCALL:
+            return compile_call(cp, node);
+        default:
+            break;
+    }
+    symb_t *n = code_node(cp, node);
+    if (n == NULL || node->type >= 0) {
+        return n;
+    }
+    int nargs = slr_rule_nargs(~node->type);
+    if ((nargs >= 1 && (n->arg1 = compile(cp, node->arg1)) == NULL) ||
+        (nargs >= 2 && (n->arg2 = compile(cp, node->arg2)) == NULL) ||
+        (nargs >= 3 && (n->arg3 = compile(cp, node->arg3)) == NULL)) {
+        return NULL;
+    }
+    fold(cp, n, nargs);
+    return n;
+}
+
+static int same_spec(const spec_t *a, const spec_t *b) {
+    if (a->mask != b->mask) {
+        return 0;
+    }
+    for (int k = 0; k < CALC_SPEC_PARAMS; k++) {
+        if ((a->mask >> k & 1) && a->vals[k] != b->vals[k]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Returns the most parser nodes that parsing the definition fundef_str
+// takes.
+static size_t parse_nodes_max(const char *fundef_str) {
+    size_t n = 0;
+    token_t tok;
+    while (get_next_tok(&tok, &fundef_str) == 0 && tok.type != TOK_EOS) {
+        n++;
+    }
+    return (n + 2) * PARSER_NODES_PER_TOKEN;
+}
+
+// Sets *code to the entry of function e specialized on spec, compiling it on
+// its min_calls-th request, or to NULL if the table is full.  Returns 1 if
+// an error was reported.
+static int get_code(code_entry_t **code, var_entry_t *e, const spec_t *spec,
+                    unsigned int min_calls) {
+    *code = NULL;
+    code_entry_t *c = NULL;
+    for (size_t i = 0; i < code_nfuncs; i++) {
+        if (code_funcs[i].var == e && same_spec(&code_funcs[i].spec, spec)) {
+            c = &code_funcs[i];
+            break;
+        }
+    }
+    if (c != NULL && (c->state != CODE_COUNTING || ++c->hits < min_calls)) {
+        *code = c;
+        return 0;
+    }
+    if (c == NULL) {
+        if (code_nfuncs == CALC_CODE_FUNCS) {
+            code_full = 1;
+            return 0;
+        }
+        c = &code_funcs[code_nfuncs++];
+        c->var = e;
+        c->spec = *spec;
+        c->hits = 1;
+        if (min_calls > 1) {
+            c->state = CODE_COUNTING;
+            *code = c;
+            return 0;
+        }
+    }
+    if (slr_mem_free() < parse_nodes_max(calc_fundef(e))) {
+        c->state = CODE_COUNTING;  // compiled on the next request
+        c->hits = min_calls - 1;
+        *code = c;
+        return 0;
+    }
+    c->state = CODE_COMPILING;
+    size_t nfuncs_mark = code_nfuncs;
+    symb_t *code_mark = code_p;
+    symb_t *mark = get_slr_mem_mark();
+    var_entry_t params[CALC_FRAME_MAX];
+    compiler_t cp = {.spec = spec};
+    symb_t *body;
+    size_t nparams;
+    int ret = parse_fundef(&body, &nparams, params, CALC_FRAME_MAX,
+                           calc_fundef(e));
+    if (ret == 0 && nparams > CALC_FRAME_MAX) {
+        cp.full = 1;
+    } else if (ret == 0) {
+        // the first of two parameters of the same name is the one seen
+        for (size_t k = nparams; k-- > 0;) {
+            cp.names[cp.nnames] = params[k].name;
+            cp.slots[cp.nnames++] = (int)k;
+        }
+        cp.nparams = nparams;
+        cp.nslots = nparams;
+        code_spec_nest += spec->mask != 0;
+        body = compile(&cp, body);
+        code_spec_nest -= spec->mask != 0;
+        ret = cp.error;
+    }
+    release_slr_mem(mark);
+    if (ret != 0 || cp.full) {
+        // drop the body, and those of callees compiled for it
+        code_p = code_mark;
+        code_nfuncs = nfuncs_mark;
+        if (ret == 0) {
+            c->state = CODE_FAILED;
+            *code = c;
+        } else if (c == &code_funcs[code_nfuncs - 1]) {
+            code_nfuncs--;  // compiled again on the next call
+        } else {
+            c->state = CODE_COUNTING;
+            c->hits = 0;
+        }
+        return ret;
+    }
+    STAT_POOL(STAT_POOL_CODE_NODES, code_p - code_mem, CALC_CODE_SIZE);
+    c->state = CODE_DONE;
+    c->body = body;
+    c->nparams = nparams;
+    c->frame_size = cp.nslots > 0 ? cp.nslots : 1;
+    c->nnodes = cp.nnodes;
+    *code = c;
+    return 0;
+}
+
+// Calls user function e, through its compiled body if it has one.  Frames
+// are only read by slot, so their names are left unset.
+static int call_user(int *result, var_entry_t *e, const symb_t *arglist_opt,
+                     var_entry_t *ctx, size_t ctx_size) {
+    if (code_active == 0 &&
+        (code_stale || code_full || code_env != calc_env)) {
+        code_flush();
+    }
+    code_entry_t *c = NULL;
+    if (!code_stale && code_env == calc_env) {
+        spec_t spec;
+        if (const_args(&spec, arglist_opt) != 0 &&
+            get_code(&c, e, &spec, SPEC_MIN_CALLS) != 0) {
+            return 1;
+        }
+        if ((c == NULL || c->state != CODE_DONE) &&
+            get_code(&c, e, &no_spec, 1) != 0) {
+            return 1;
+        }
+    }
+    if (c == NULL || c->state != CODE_DONE) {
+        return call_function(result, calc_fundef(e), arglist_opt, ctx,
+                             ctx_size);
+    }
+    if (count_args(arglist_opt) != c->nparams)
+        CALC_DIE("wrong number of arguments");
+    var_entry_t frame[c->frame_size];
+    code_active++;
+    int ret;
+    if (calc_args == CALC_ARGS_LAZY) {
+        ret = eval_lazy_call(result, c->body, frame, c->frame_size,
+                             arglist_opt, ctx, ctx_size);
+    } else if ((ret = eval_args(frame, arglist_opt, ctx, ctx_size)) == 0) {
+        ret = do_eval_ctx(result, c->body, frame, c->frame_size);
+    }
+    code_active--;
+    return ret;
+}
+
+static int call_inline(int *result, const symb_t *call, var_entry_t *ctx,
+                       size_t ctx_size) {
+    var_entry_t *e = (var_entry_t *)(uintptr_t)call->frame.callee;
+    if (use_global(e) != 0) return 1;
+    size_t slot = (size_t)call->frame.slot;
+    STAT_INC(calls);
+    PROF_ENTER(e->name);
+    int ret;
+    if (calc_args == CALC_ARGS_LAZY) {
+        ret = eval_lazy_call(result, call->frame.body, &ctx[slot],
+                             ctx_size - slot, call->frame.args, ctx, ctx_size);
+    } else if ((ret = eval_args(&ctx[slot], call->frame.args, ctx,
+                                ctx_size)) == 0) {
+        ret = do_eval_ctx(result, call->frame.body, &ctx[slot],
+                          ctx_size - slot);
+    }
+    PROF_EXIT();
+    return ret;
+}
+
+// =========
+// snapshots
+// =========
+
+// A snapshot holds the variable slots in use, the binding state and the used
+// part of the fundef buffer.  Functions and bindings stay source text, as in
+// memory, and are referred to by their offset in the buffer, so a snapshot is
+// restored with plain copies.  Integers are little-endian.
+//
+//   header   "MCSN", version, size, checksum of the rest, nvars, fundefs
+//            length
+//   vars     nvars records: name[4], value, fundef offset, formula offset,
+//            flags, dependency bitset; absent offsets are SNAP_NONE
+//   fundefs  the fundef buffer
+
+#define SNAP_VERSION 1
+#define SNAP_HEADER_SIZE 24
+#define SNAP_RECORD_SIZE (20 + 4 * DEPS_WORDS)
+#define SNAP_NONE 0xffffffffu
+
+static unsigned char *put_u32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+    return p + 4;
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+           (uint32_t)p[3] << 24;
+}
+
+static uint32_t checksum(const unsigned char *p, size_t len) {
+    uint32_t h = 2166136261u;  // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+// Writes a snapshot of the variables and functions of calc_env, without its
+// base, to buf, which must have room for CALC_SNAPSHOT_MAX bytes, and
+// returns its size.
+size_t calc_save(unsigned char *buf) {
+    const calc_env_t *env = calc_env;
+    // slots are never freed, so the ones in use are a prefix
+    size_t nvars = 0;
+    while (nvars < CALC_VAR_SIZE &&
+           NAME_AS_INT(env->vars[nvars].name) != 0) {
+        nvars++;
+    }
+    size_t fundefs_len = (size_t)(env->fundefs_p - env->fundefs);
+    size_t size = SNAP_HEADER_SIZE + nvars * SNAP_RECORD_SIZE + fundefs_len;
+    unsigned char *p = buf;
+    *p++ = 'M';
+    *p++ = 'C';
+    *p++ = 'S';
+    *p++ = 'N';
+    p = put_u32(p, SNAP_VERSION);
+    p = put_u32(p, (uint32_t)size);
+    p += 4;  // checksum
+    p = put_u32(p, (uint32_t)nvars);
+    p = put_u32(p, (uint32_t)fundefs_len);
+    for (size_t i = 0; i < nvars; i++) {
+        const var_entry_t *e = &env->vars[i];
+        for (int k = 0; k < 4; k++) {
+            *p++ = (unsigned char)e->name[k];
+        }
+        p = put_u32(p, (uint32_t)e->val);
+        p = put_u32(p, e->fundef == NULL
+                           ? SNAP_NONE
+                           : (uint32_t)((char *)e->fundef - env->fundefs));
+        p = put_u32(p, env->formulas[i] == NULL
+                           ? SNAP_NONE
+                           : (uint32_t)(env->formulas[i] - env->fundefs));
+        p = put_u32(p, env->var_flags[i]);
+        for (size_t w = 0; w < DEPS_WORDS; w++) {
+            p = put_u32(p, env->deps[i][w]);
+        }
+    }
+    for (size_t i = 0; i < fundefs_len; i++) {
+        *p++ = (unsigned char)env->fundefs[i];
+    }
+    put_u32(buf + 12, checksum(buf + 16, size - 16));
+    return size;
+}
+
+// Checks that off is SNAP_NONE or the start of a string in the fundefs of a
+// snapshot.
+static int valid_offset(uint32_t off, const unsigned char *fundefs_data,
+                        size_t fundefs_len) {
+    if (off == SNAP_NONE) {
+        return 1;
+    }
+    for (size_t i = off; i < fundefs_len; i++) {
+        if (fundefs_data[i] == '\0') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Replaces the variables and functions of calc_env with the snapshot in buf.
+// Nothing is changed if the snapshot is invalid.
+int calc_load(const unsigned char *buf, size_t size) {
+    calc_env_t *env = calc_env;
+    if (env->ncheckpoints > 0) CALC_DIE("cannot load during a checkpoint");
+    if (size < SNAP_HEADER_SIZE || buf[0] != 'M' || buf[1] != 'C' ||
+        buf[2] != 'S' || buf[3] != 'N')
+        CALC_DIE("not a snapshot");
+    if (get_u32(buf + 4) != SNAP_VERSION)
+        CALC_DIE("unsupported snapshot version");
+    if (get_u32(buf + 8) != size) CALC_DIE("truncated snapshot");
+    if (get_u32(buf + 12) != checksum(buf + 16, size - 16))
+        CALC_DIE("snapshot checksum mismatch");
+    size_t nvars = get_u32(buf + 16);
+    size_t fundefs_len = get_u32(buf + 20);
+    if (nvars > CALC_VAR_SIZE || fundefs_len > CALC_FUNDEF_BUFSIZE ||
+        size != SNAP_HEADER_SIZE + nvars * SNAP_RECORD_SIZE + fundefs_len)
+        CALC_DIE("corrupt snapshot");
+    const unsigned char *records = buf + SNAP_HEADER_SIZE;
+    const unsigned char *fundefs_data = records + nvars * SNAP_RECORD_SIZE;
+    for (size_t i = 0; i < nvars; i++) {
+        const unsigned char *r = records + i * SNAP_RECORD_SIZE;
+        if (!valid_offset(get_u32(r + 8), fundefs_data, fundefs_len) ||
+            !valid_offset(get_u32(r + 12), fundefs_data, fundefs_len))
+            CALC_DIE("corrupt snapshot");
+    }
+
+    for (size_t i = 0; i < fundefs_len; i++) {
+        env->fundefs[i] = (char)fundefs_data[i];
+    }
+    env->fundefs_p = env->fundefs + fundefs_len;
+    for (size_t i = 0; i < CALC_VAR_SIZE; i++) {
+        var_entry_t *e = &env->vars[i];
+        if (i >= nvars) {
+            NAME_AS_INT(e->name) = 0;
+            e->val = 0;
+            e->fundef = NULL;
+            unbind_var(i);
+            continue;
+        }
+        const unsigned char *r = records + i * SNAP_RECORD_SIZE;
+        for (int k = 0; k < 4; k++) {
+            e->name[k] = (char)r[k];
+        }
+        e->val = (int)get_u32(r + 4);
+        uint32_t off = get_u32(r + 8);
+        e->fundef = off == SNAP_NONE ? NULL : &env->fundefs[off];
+        off = get_u32(r + 12);
+        env->formulas[i] = off == SNAP_NONE ? NULL : &env->fundefs[off];
+        env->var_flags[i] = (unsigned char)(get_u32(r + 16) & VAR_DIRTY);
+        for (size_t w = 0; w < DEPS_WORDS; w++) {
+            env->deps[i][w] = get_u32(r + 20 + 4 * w);
+        }
+    }
+    STAT_POOL(STAT_POOL_VARS, nvars, CALC_VAR_SIZE);
+    STAT_POOL(STAT_POOL_FUNDEF_BYTES, fundefs_len, CALC_FUNDEF_BUFSIZE);
+    code_stale = 1;
+    return 0;
+}
+
+// =========
+// libraries
+// =========
+
+// A library image is calc_env frozen and used in place: a process maps it
+// read-only and looks names up in it as in any base, so its definitions
+// are shared by all processes mapping it and nothing is copied or parsed
+// to attach it.  Functions are still compiled on their first call, in each
+// process.
+
+// Writes an image of calc_env, with its bindings brought up to date, to
+// image.  calc_env itself is not frozen.
+int calc_publish(calc_image_t *image) {
+    calc_env_t *env = calc_env;
+    if (env->base != NULL) CALC_DIE("environment has a base");
+    if (update_bindings(env) != 0) return 1;
+    unsigned char *p = (unsigned char *)image;
+    const unsigned char *q = (const unsigned char *)env;
+    for (size_t i = 0; i < sizeof(*image); i++) {
+        p[i] = 0;
+    }
+    p = (unsigned char *)&image->env;
+    for (size_t i = 0; i < sizeof(*env); i++) {
+        p[i] = q[i];
+    }
+    image->magic[0] = 'M';
+    image->magic[1] = 'C';
+    image->magic[2] = 'I';
+    image->magic[3] = 'M';
+    image->size = sizeof(*image);
+    drop_pointers(&image->env, env->fundefs);
+    image->checksum =
+        checksum((const unsigned char *)&image->env, sizeof(image->env));
+    return 0;
+}
+
+// Checks the image in buf, mapped at any address, and makes it the base of
+// env.  Bindings of env are recomputed, as names may now resolve in the
+// base.
+int calc_attach(calc_env_t *env, const void *buf, size_t size) {
+    const calc_image_t *image = buf;
+    if (size < sizeof(image->magic) || image->magic[0] != 'M' ||
+        image->magic[1] != 'C' || image->magic[2] != 'I' ||
+        image->magic[3] != 'M')
+        CALC_DIE("not a library image");
+    if (size != sizeof(*image) || image->size != sizeof(*image))
+        CALC_DIE("library image of another build");
+    const calc_env_t *lib = &image->env;
+    if (image->checksum !=
+        checksum((const unsigned char *)lib, sizeof(*lib)))
+        CALC_DIE("library image checksum mismatch");
+    if (!lib->frozen || lib->base != NULL) CALC_DIE("corrupt library image");
+    for (size_t i = 0; i < CALC_VAR_SIZE; i++) {
+        uintptr_t off = (uintptr_t)lib->vars[i].fundef;
+        if (lib->var_flags[i] != 0 ||
+            (off != 0 &&
+             (off > CALC_FUNDEF_BUFSIZE ||
+              !valid_offset((uint32_t)(off - 1),
+                            (const unsigned char *)lib->fundefs,
+                            CALC_FUNDEF_BUFSIZE))))
+            CALC_DIE("corrupt library image");
+    }
+    env->base = lib;
+    for (size_t i = 0; i < CALC_VAR_SIZE; i++) {
+        if (env->formulas[i] != NULL) {
+            save_slot(i);
+            env->var_flags[i] |= VAR_DIRTY;
+        }
     }
-    return do_eval_ctx(result, fundef->arg1->arg1->arg3, scope, argc);
+    code_stale = 1;
+    return 0;
 }
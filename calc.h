@@ -6,15 +6,150 @@
 #define MINCALC_CALC_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "parser.h"
 
+#define CALC_VAR_SIZE 128
+#define CALC_FUNDEF_BUFSIZE 2048
+#define CALC_DEPS_WORDS ((CALC_VAR_SIZE + 31) / 32)
+
+// compiled function bodies, see calc.c
+#define CALC_CODE_SIZE 1024  // nodes
+#define CALC_CODE_FUNCS 128  // including specializations
+#define CALC_FRAME_MAX 32  // slots
+#define CALC_CALL_DEPTH 256
+#define CALC_SPEC_PARAMS 8  // leading parameters a body is specialized on
+// nested (:begin); the FPGA build keeps its undo log small
+#ifdef __FPGA_EXP__
+#define CALC_CHECKPOINTS 1
+#else
+#define CALC_CHECKPOINTS 4
+#endif
+
+// Node types of compiled function bodies, after NODE_SHARED (cse.h).
+// NODE_GLOBAL nodes are tokens naming a global variable.  NODE_ARG nodes
+// are slots holding a parameter that may not have been evaluated yet.
+#define NODE_SLOT (~(NRULES + 1))
+#define NODE_GLOBAL (~(NRULES + 2))
+#define NODE_INLINE (~(NRULES + 3))
+#define NODE_ARG (~(NRULES + 4))
+
+// upper bound of the size of a snapshot (calc_save)
+#define CALC_SNAPSHOT_MAX \
+    (24 + CALC_VAR_SIZE * (20 + CALC_DEPS_WORDS * 4) + CALC_FUNDEF_BUFSIZE)
+
 typedef struct {
     char name[4];
     int val;
     void *fundef;
 } var_entry_t;
 
+// A variable slot as it was before its first change after a checkpoint, and
+// the checkpoint it had been saved for before.
+typedef struct {
+    var_entry_t var;
+    const char *formula;
+    uint32_t deps[CALC_DEPS_WORDS];
+    uint32_t saved_in;
+    unsigned short slot;
+    unsigned char flags;
+} calc_undo_t;
+
+// The undo log of the checkpoints of an environment.  It is kept apart,
+// so that environments without checkpoints, such as library images, do not
+// carry it; it is given with calc_set_undo_log before the first calc_begin.
+typedef struct {
+    uint32_t saved_in[CALC_VAR_SIZE];  // checkpoint ID
+    calc_undo_t undo[CALC_CHECKPOINTS * CALC_VAR_SIZE];
+    size_t nundo;
+} calc_undo_log_t;
+
+typedef struct {
+    uint32_t id;
+    size_t nundo;  // length of the undo log when it was begun
+    char *fundefs_p;
+    const struct calc_env *base;
+} calc_checkpoint_t;
+
+// The variables and functions of a session.  An environment may be layered
+// over a read-only base: names it does not define are looked up in the base,
+// and assigning to one of them creates a slot that shadows it.
+typedef struct calc_env {
+    var_entry_t vars[CALC_VAR_SIZE];
+    char fundefs[CALC_FUNDEF_BUFSIZE];
+    char *fundefs_p;
+    // bindings (x ::= expr), see calc.c
+    const char *formulas[CALC_VAR_SIZE];
+    unsigned char var_flags[CALC_VAR_SIZE];
+    uint32_t deps[CALC_VAR_SIZE][CALC_DEPS_WORDS];
+    size_t cur_binding;
+    const struct calc_env *base;
+    int frozen;  // see calc_env_freeze
+    // checkpoints (calc_begin), see calc.c
+    calc_checkpoint_t checkpoints[CALC_CHECKPOINTS];
+    size_t ncheckpoints;
+    uint32_t last_checkpoint;  // ID
+    calc_undo_log_t *log;      // NULL until given
+} calc_env_t;
+
+// A frozen environment as published to a file, or to shared memory under
+// /dev/shm, by calc_publish, for other processes to map read-only as their
+// base (calc_attach).  Its layout is that of the build, which size checks.
+typedef struct {
+    char magic[4];  // "MCIM"
+    uint32_t size;  // sizeof(calc_image_t)
+    uint32_t checksum;  // of env
+    calc_env_t env;
+} calc_image_t;
+
+// the environment statements are run in; initially an empty one
+extern calc_env_t *calc_env;
+
+// How arguments of user functions are passed, see calc.c.  Set with
+// calc_set_args.
+enum calc_args {
+    CALC_ARGS_EAGER,  // all evaluated before the body, the default
+    CALC_ARGS_LAZY,   // each evaluated on its first use, if any
+};
+
+extern enum calc_args calc_args;
+
+void calc_set_args(enum calc_args mode);
+
+// Limits of the evaluation of a statement, 0 for none, checked by
+// do_eval_ctx; see calc.c.  The FPGA build has no clock to time with.
+typedef struct {
+    unsigned long nodes;
+#ifndef __FPGA_EXP__
+    unsigned long ms;
+#endif
+} calc_limits_t;
+
+// Starts the limits over; called before each statement.
+void calc_start_statement(const calc_limits_t *limits);
+#ifndef __FPGA_EXP__
+// Makes the statement being evaluated fail with an error; safe to call from
+// a signal handler.
+void calc_interrupt(void);
+#endif
+
+void calc_env_init(calc_env_t *env, const calc_env_t *base);
+int calc_env_freeze(calc_env_t *env);
+int calc_publish(calc_image_t *image);
+
+// Checkpoints of calc_env: calc_rollback undoes all changes since the last
+// calc_begin, calc_commit keeps them.  Checkpoints nest.  calc_begin needs
+// an undo log, which calc_set_undo_log gives calc_env while it has no
+// checkpoints; it must outlive the environment's use of it.
+void calc_set_undo_log(calc_undo_log_t *log);
+int calc_begin(void);
+int calc_rollback(void);
+int calc_commit(void);
+// Whether base is the base of env or would be after a calc_rollback.
+int calc_uses_base(const calc_env_t *env, const calc_env_t *base);
+int calc_attach(calc_env_t *env, const void *buf, size_t size);
+
 var_entry_t *lookup_var(const char *name);
 var_entry_t *create_var(const char *name);
 var_entry_t *get_or_create_var(const char *name);
@@ -22,11 +157,23 @@ var_entry_t *get_or_create_var(const char *name);
 var_entry_t *lookup_var_ctx(const char *name, var_entry_t *ctx,
                             size_t ctx_size);
 
+// Returns the definition of e, a function of calc_env or of its base.
+const char *calc_fundef(const var_entry_t *e);
+
 int do_svar(const symb_t *symb, const char *input);
 int do_eval(int *result, const symb_t *symb);
 int do_eval_ctx(int *result, const symb_t *symb, var_entry_t *ctx,
                 size_t ctx_size);
-int call_function(int *result, const char *fundef_str, symb_t *arglist_opt,
-                  var_entry_t *ctx, size_t ctx_size);
+// Parses a stored function definition into parser memory.  Sets *body,
+// stores the number of parameters in *nparams and the names of the first
+// max_params of them in scope.
+int parse_fundef(symb_t **body, size_t *nparams, var_entry_t *scope,
+                 size_t max_params, const char *fundef_str);
+int call_function(int *result, const char *fundef_str,
+                  const symb_t *arglist_opt, var_entry_t *ctx,
+                  size_t ctx_size);
+
+size_t calc_save(unsigned char *buf);
+int calc_load(const unsigned char *buf, size_t size);
 
 #endif /* MINCALC_CALC_H */
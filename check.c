@@ -0,0 +1,203 @@
+/*
+ * check.c
+ */
+
+// Checks the soft arithmetic of arith.c against the machine operators, and
+// the evaluator on cases that its shortcuts have got wrong.  Host only; make
+// check builds and runs it.
+//
+// usage: mincalc-check
+//
+// Every pair of a set of edge operands (0, +-1, INT_MIN, INT_MAX and the
+// powers of two and their neighbours) is checked, then random pairs, then
+// arith_div10 on all 2^32 inputs.  Mismatches are printed and the exit
+// status is 1.  INT_MIN / -1 must wrap to INT_MIN with remainder 0, as the
+// evaluator does; division by 0 is left to callers and not checked.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "arith.h"
+#include "calc.h"
+#include "cse.h"
+#include "lexer.h"
+#include "parser.h"
+#include "stats.h"
+
+static unsigned long failures;
+
+static void fail(const char *what, uint32_t a, uint32_t b, uint32_t got,
+                 uint32_t want) {
+    if (failures++ < 20) {
+        fprintf(stderr, "%s(0x%08lx, 0x%08lx) = 0x%08lx, want 0x%08lx\n",
+                what, (unsigned long)a, (unsigned long)b,
+                (unsigned long)got, (unsigned long)want);
+    }
+}
+
+static void check_pair(uint32_t ua, uint32_t ub) {
+    int32_t a = (int32_t)ua;
+    int32_t b = (int32_t)ub;
+    uint32_t want = ua * ub;
+    uint32_t got = (uint32_t)arith_mul(a, b);
+    if (got != want) fail("arith_mul", ua, ub, got, want);
+    if (b == 0) {
+        return;
+    }
+    uint32_t urem;
+    got = arith_udivmod(ua, ub, &urem);
+    if (got != ua / ub) fail("arith_udivmod", ua, ub, got, ua / ub);
+    if (urem != ua % ub) fail("arith_udivmod rem", ua, ub, urem, ua % ub);
+    // the C operators trap or are undefined on INT_MIN / -1
+    uint32_t wq = b == -1 ? 0u - ua : (uint32_t)(a / b);
+    uint32_t wr = b == -1 ? 0 : (uint32_t)(a % b);
+    int32_t rem;
+    got = (uint32_t)arith_divmod(a, b, &rem);
+    if (got != wq) fail("arith_divmod", ua, ub, got, wq);
+    if ((uint32_t)rem != wr) {
+        fail("arith_divmod rem", ua, ub, (uint32_t)rem, wr);
+    }
+    got = (uint32_t)arith_div(a, b);
+    if (got != wq) fail("arith_div", ua, ub, got, wq);
+    got = (uint32_t)arith_mod(a, b);
+    if (got != wr) fail("arith_mod", ua, ub, got, wr);
+}
+
+#define NEDGE (5 + 6 * 31)
+
+static uint32_t edge[NEDGE];
+
+static void setup_edge(void) {
+    int n = 0;
+    edge[n++] = 0;
+    edge[n++] = 1;
+    edge[n++] = 0xffffffffu;  // -1
+    edge[n++] = 0x7fffffffu;  // INT_MAX
+    edge[n++] = 10;
+    for (int k = 1; k < 32; k++) {
+        uint32_t p = (uint32_t)1 << k;  // INT_MIN for k = 31
+        edge[n++] = p;
+        edge[n++] = 0u - p;
+        edge[n++] = p + 1;
+        edge[n++] = 0u - (p + 1);
+        edge[n++] = p - 1;
+        edge[n++] = 0u - (p - 1);
+    }
+}
+
+static void check_arith(void) {
+    setup_edge();
+    for (int i = 0; i < NEDGE; i++) {
+        for (int j = 0; j < NEDGE; j++) {
+            check_pair(edge[i], edge[j]);
+        }
+    }
+    // random operands of random lengths, so that quotients of all sizes
+    // come up
+    uint32_t x = 1;
+    for (long i = 0; i < 1000000; i++) {
+        x = x * 1664525u + 1013904223u;
+        uint32_t a = x >> (x & 31);
+        x = x * 1664525u + 1013904223u;
+        uint32_t b = x >> (x & 31);
+        check_pair(x & 0x10000 ? 0u - a : a, x & 0x20000 ? 0u - b : b);
+    }
+    uint32_t n = 0;
+    do {
+        uint32_t got = arith_div10(n);
+        if (got != n / 10) fail("arith_div10", n, 10, got, n / 10);
+    } while (++n != 0);
+}
+
+// =========
+// evaluator
+// =========
+
+static void fail_calc(const char *line, const char *what, long got,
+                      long want) {
+    if (failures++ < 20) {
+        fprintf(stderr, "%s: %s %ld, want %ld\n", line, what, got, want);
+    }
+}
+
+// Runs a definition, as session.c does.
+static void define(const char *line) {
+    const char *p = line;
+    token_t tok;
+    init_slr_svar();
+    do {
+        if (get_next_tok(&tok, &p) != 0 || slr_feed_token(&tok) != 0) {
+            fail_calc(line, "error", 1, 0);
+            clear_slr_mem();
+            return;
+        }
+    } while (tok.type != TOK_EOS);
+    symb_t *symb = slr_get_result();
+    if (symb == NULL || do_svar(cse_intern(symb), line) != 0) {
+        fail_calc(line, "error", 1, 0);
+    }
+    clear_slr_mem();
+}
+
+// Evaluates line and checks its value and, unless it is -1, the number of
+// function calls it makes.
+static void expect(const char *line, int want, long want_calls) {
+    static const calc_limits_t no_limits;
+    unsigned long calls = mc_stats.calls;
+    const char *p = line;
+    symb_t *symb;
+    int val;
+    calc_start_statement(&no_limits);
+    if (prec_parse_expr(&symb, &p) != 0 || symb == NULL ||
+        do_eval(&val, cse_intern(symb)) != 0) {
+        fail_calc(line, "error", 1, 0);
+    } else if (val != want) {
+        fail_calc(line, "=", val, want);
+    }
+    clear_slr_mem();
+    long ncalls = (long)(mc_stats.calls - calls);
+    if (want_calls >= 0 && ncalls != want_calls) {
+        fail_calc(line, "calls", ncalls, want_calls);
+    }
+}
+
+static void check_calc(void) {
+    // Recursion guarded by an empty range: the calls past the guard are
+    // never made, so compiling must not specialize them without end.
+    define("fib(n) := (n<2)*n + sum(i, 1, n>=2, fib(n-1)+fib(n-2))");
+    for (int k = 0; k < 3; k++) {
+        expect("fib(10)", 55, -1);
+    }
+    expect("fib(12)", 144, -1);
+    expect("fib(1)", 1, -1);
+    // a call per call made; the closed form of sums must not add any
+    expect("fib(10) + 0 * fib(1)", 55, 178);
+
+    // Sums evaluate their body only at points of their range, so a single
+    // term is one evaluation, and a body independent of i is evaluated
+    // once whatever the length of the range.
+    define("g(x) := x + 1");
+    expect("sum(i, 1, 0, g(5))", 0, 0);
+    expect("sum(i, 1, 1, g(5))", 6, 1);
+    expect("sum(i, 3, 3, i * g(5))", 18, 1);
+    expect("sum(i, 1, 4, g(5))", 24, 1);
+    expect("sum(i, 1, 4, i * g(5))", 60, 2);
+    expect("sum(i, 0 - 2147483647 - 1, 2147483647, g(5))", 0, 1);
+    // the closed form against the loop, which a division forces
+    expect("sum(i, 2147483640, 2147483647, i * 3 + 1)", -100, 0);
+    expect("sum(i, 2147483640, 2147483647, (i * 3 + 1) / 1)", -100, 0);
+    expect("sum(i, 0 - 2147483647 - 1, 0 - 2147483640, 5 - 7 * i)",
+           2147483441, 0);
+    expect("sum(i, 0 - 100, 100, i * 3 + 1)", 201, 0);
+}
+
+int main(void) {
+    check_arith();
+    check_calc();
+    if (failures != 0) {
+        fprintf(stderr, "check: %lu failures\n", failures);
+        return 1;
+    }
+    puts("check: soft arithmetic and evaluator match");
+    return 0;
+}
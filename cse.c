@@ -0,0 +1,186 @@
+/*
+ * cse.c
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stats.h"
+
+#include "cse.h"
+
+// Common subexpression elimination.  cse_intern copies a parsed statement
+// into its own node pool, hash-consing every subtree, so that structurally
+// identical subtrees become one node.  When an expression is found again, its
+// node is turned into a NODE_SHARED wrapper in place: the evaluator computes
+// it once per epoch and every parent sees the cached value.
+//
+// Only trees of whole statements are interned.  Their nodes are evaluated in
+// the global context, so one epoch per statement is enough, except in the
+// bodies of reductions, which advance it whenever the values of their bound
+// variables change (calc.c); function bodies are parsed per call and never
+// interned.
+
+#define CSE_POOL_SIZE 1024
+#define CSE_TABLE_SIZE 2048  // power of two, > CSE_POOL_SIZE
+
+typedef struct {
+    symb_t *node;
+    uint32_t hash;
+    unsigned int gen;  // the slot is empty unless gen == table_gen
+    int is_expr;
+} cse_slot_t;
+
+static symb_t pool[CSE_POOL_SIZE];
+static symb_t *pool_p = pool;
+static cse_slot_t table[CSE_TABLE_SIZE];
+static unsigned int table_gen = 1;
+
+enum cse_mode cse_mode = CSE_ON;
+unsigned int cse_epoch;
+
+void cse_reset() {
+    pool_p = pool;
+    table_gen++;
+}
+
+// Whether the k-th child of nodes of the given type is evaluated as an
+// expression.  Only those may be replaced by NODE_SHARED wrappers; the
+// others are inspected by the evaluator.
+static int child_is_expr(int type, int k) {
+    switch (~type) {
+        case RL_STMT_SETVAR:
+        case RL_SETVAR_ASSIGN:
+        case RL_SETVAR_FUNDEF:
+        case RL_SETVAR_BIND:
+        case RL_FUNDEF:
+        case RL_FUNCALL:
+        case RL_IDLIST_OPT_0:
+        case RL_IDLIST_OPT_1:
+        case RL_IDLIST:
+        case RL_IDLIST_CONS:
+        case RL_ARGLIST_OPT_0:
+        case RL_ARGLIST_OPT_1:
+            return 0;
+        case RL_ASSIGN:
+        case RL_BIND:
+            return k == 2;
+        case RL_ARGLIST:
+        case RL_ARGLIST_CONS:
+            return k == 1;
+        default:
+            return 1;
+    }
+}
+
+static uint32_t mix(uint32_t h, uint32_t v) { return (h ^ v) * 16777619u; }
+
+static int same_node(const symb_t *a, const symb_t *b, int nargs) {
+    if (a->type == NODE_SHARED) {
+        a = a->shared.body;
+    }
+    if (a->type != b->type) {
+        return 0;
+    }
+    if (a->type >= 0) {
+        if (a->type != TOK_NUM && a->type != TOK_ID) {
+            return 1;
+        }
+        return a->token.num == b->token.num;
+    }
+    return (nargs < 1 || a->arg1 == b->arg1) &&
+           (nargs < 2 || a->arg2 == b->arg2) &&
+           (nargs < 3 || a->arg3 == b->arg3);
+}
+
+static symb_t *new_node(void) {
+    if (pool_p - pool >= CSE_POOL_SIZE) {
+        return NULL;
+    }
+    return pool_p++;
+}
+
+// Returns the canonical copy of node, or NULL when the pool is full.
+static symb_t *intern(const symb_t *node, int is_expr) {
+    symb_t key;
+    int nargs = 0;
+    uint32_t h = mix(2166136261u, (uint32_t)node->type);
+    if (node->type >= 0) {
+        key.token.type = node->token.type;
+        key.token.num = 0;
+        if (node->type == TOK_NUM || node->type == TOK_ID) {
+            key.token.num = node->token.num;
+        }
+        h = mix(h, (uint32_t)key.token.num);
+    } else {
+        key.type = node->type;
+        nargs = slr_rule_nargs(~node->type);
+        if (nargs >= 1) {
+            key.arg1 = intern(node->arg1, child_is_expr(node->type, 1));
+            if (key.arg1 == NULL) return NULL;
+            h = mix(h, (uint32_t)(uintptr_t)key.arg1);
+        }
+        if (nargs >= 2) {
+            key.arg2 = intern(node->arg2, child_is_expr(node->type, 2));
+            if (key.arg2 == NULL) return NULL;
+            h = mix(h, (uint32_t)(uintptr_t)key.arg2);
+        }
+        if (nargs >= 3) {
+            key.arg3 = intern(node->arg3, child_is_expr(node->type, 3));
+            if (key.arg3 == NULL) return NULL;
+            h = mix(h, (uint32_t)(uintptr_t)key.arg3);
+        }
+    }
+    h = mix(h, (uint32_t)is_expr);
+
+    size_t i = h & (CSE_TABLE_SIZE - 1);
+    for (; table[i].gen == table_gen; i = (i + 1) & (CSE_TABLE_SIZE - 1)) {
+        cse_slot_t *slot = &table[i];
+        if (slot->hash != h || slot->is_expr != is_expr ||
+            !same_node(slot->node, &key, nargs)) {
+            continue;
+        }
+        symb_t *c = slot->node;
+        if (is_expr && c->type != NODE_SHARED && c->type != TOK_NUM) {
+            // seen again: move the subtree into a new node and make c the
+            // wrapper, so that earlier parents share the cached value too
+            symb_t *body = new_node();
+            if (body == NULL) return NULL;
+            *body = *c;
+            c->shared.type = NODE_SHARED;
+            c->shared.body = body;
+            c->shared.epoch = cse_epoch - 1;
+        }
+        return c;
+    }
+
+    // the pool never holds more nodes than half the table, so there is
+    // always an empty slot
+    symb_t *c = new_node();
+    if (c == NULL) return NULL;
+    *c = key;
+    table[i].node = c;
+    table[i].hash = h;
+    table[i].gen = table_gen;
+    table[i].is_expr = is_expr;
+    return c;
+}
+
+symb_t *cse_intern(symb_t *root) {
+    if (cse_mode == CSE_OFF || root == NULL) {
+        return root;
+    }
+    cse_epoch++;
+    if (cse_mode != CSE_KEEP) {
+        cse_reset();
+    }
+    symb_t *r = intern(root, 0);
+    STAT_POOL(STAT_POOL_CSE_NODES, pool_p - pool, CSE_POOL_SIZE);
+    if (r == NULL) {
+        // out of space: start over with the next statement and evaluate
+        // this one as parsed
+        cse_reset();
+        return root;
+    }
+    return r;
+}
@@ -0,0 +1,27 @@
+/*
+ * cse.h
+ */
+
+#ifndef MINCALC_CSE_H
+#define MINCALC_CSE_H
+
+#include "parser.h"
+
+// Type of the nodes wrapping a subtree that occurs more than once in an
+// interned tree.  The value of the subtree (shared.body) is cached in the
+// node and is valid while shared.epoch == cse_epoch.
+#define NODE_SHARED (~NRULES)
+
+enum cse_mode {
+    CSE_OFF,
+    CSE_ON,    // one table per statement
+    CSE_KEEP,  // the table is kept across statements
+};
+
+extern enum cse_mode cse_mode;
+extern unsigned int cse_epoch;
+
+void cse_reset(void);
+symb_t *cse_intern(symb_t *root);
+
+#endif /* MINCALC_CSE_H */
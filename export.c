@@ -0,0 +1,834 @@
+/*
+ * export.c
+ */
+
+// :export PATH translates the user's functions into C.  With NAME the base
+// name of PATH, PATH.c defines and PATH.h declares for each function
+//
+//     f(x, y) := ...
+//     int NAME_f(int32_t *result, int32_t p0, int32_t p1);
+//
+// which stores the value of the call in *result and returns 0 where mincalc
+// gives a value.  Where mincalc reports an error, it calls the error hook
+//
+//     void (*NAME_error_hook)(const char *func, const char *msg);
+//
+// unless it is NULL, with the name of the function that failed and the
+// message mincalc prints, such as "division by zero", and returns 1.  Calls
+// are plain C calls, nested at most CALC_CALL_DEPTH deep as in mincalc, and
+// the reductions are loops.  Arguments are evaluated before the call
+// whatever :args says.
+//
+// The code computes what do_eval_ctx does: integers wrap around in 32 bits,
+// / and % truncate, INT_MIN / -1 wraps and x % -1 is 0, shift counts are
+// taken modulo 32 as by the host's shift instructions, and >>> shifts in
+// zeros.  It assumes, as the evaluator does, that converting an unsigned
+// value to int32_t wraps around and that >> shifts in the sign bit.
+//
+// The global variables the functions read become variables NAME_x of the
+// same value, which the program may change; a binding is exported as its
+// current value.  A name that does not resolve fails the call where it is
+// reached, as it does in mincalc.
+
+#ifndef __FPGA_EXP__
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtin.h"
+#include "calc.h"
+#include "io.h"
+#include "stats.h"
+
+#include "export.h"
+
+#define EXPORT_DIE(msg)               \
+    do {                              \
+        mc_error("COMMAND", msg);     \
+        STAT_ERROR(STAT_ERR_COMMAND); \
+        return 1;                     \
+    } while (0)
+
+#define EXPORT_FUNCS (2 * CALC_VAR_SIZE)  // own and base
+#define EXPORT_NAME_MAX 32  // of the prefix
+#define EXPORT_LOCALS 256  // parameters and bound variables in scope
+#define VAL_SIZE (EXPORT_NAME_MAX + 16)  // operand text
+
+typedef struct {
+    char name[4];
+    const char *fundef;
+    size_t nparams;
+} export_fn_t;
+
+// A name bound in the body being written: a parameter pN or a variable tN
+// of a reduction.  The innermost binding comes last.
+typedef struct {
+    char name[4];
+    char val[VAL_SIZE];
+    int used;
+} local_t;
+
+static export_fn_t fns[EXPORT_FUNCS];
+static size_t nfns;
+static char globals[EXPORT_FUNCS][4];
+static size_t nglobals;
+
+static FILE *out;
+static char prefix[EXPORT_NAME_MAX + 1];
+static const export_fn_t *cur_fn;
+static local_t locals[EXPORT_LOCALS];
+static size_t nlocals;
+static unsigned int ntemps;
+static int depth_used;
+static int level;  // of indentation
+
+static int same_name(const char *a, const char *b) {
+    return memcmp(a, b, 4) == 0;
+}
+
+static int by_name(const void *a, const void *b) {
+    return memcmp(((const export_fn_t *)a)->name,
+                  ((const export_fn_t *)b)->name, 4);
+}
+
+static const export_fn_t *find_fn(const char *name) {
+    for (size_t i = 0; i < nfns; i++) {
+        if (same_name(fns[i].name, name)) {
+            return &fns[i];
+        }
+    }
+    return NULL;
+}
+
+// Adds the functions of vars that name resolves to.
+static int collect_fns(const var_entry_t *vars) {
+    for (size_t i = 0; i < CALC_VAR_SIZE; i++) {
+        const var_entry_t *e = &vars[i];
+        if (e->name[0] == '\0' || e->fundef == NULL ||
+            lookup_var(e->name) != e) {
+            continue;
+        }
+        export_fn_t *f = &fns[nfns++];
+        memcpy(f->name, e->name, 4);
+        f->fundef = calc_fundef(e);
+        symb_t *mark = get_slr_mem_mark();
+        symb_t *body;
+        int ret = parse_fundef(&body, &f->nparams, NULL, 0, f->fundef);
+        release_slr_mem(mark);
+        if (ret != 0) return 1;
+    }
+    return 0;
+}
+
+// ======
+// output
+// ======
+
+// Writes a line of the body at the current indentation.
+static void emit(const char *fmt, ...) {
+    va_list ap;
+    fprintf(out, "%*s", 4 * level, "");
+    va_start(ap, fmt);
+    vfprintf(out, fmt, ap);
+    va_end(ap);
+    fputc('\n', out);
+}
+
+static void emit_fail(const char *msg) {
+    emit("return fail(\"%.4s\", \"%s\");", cur_fn->name, msg);
+}
+
+// Fails unconditionally; the code after it is not reached, so the value is
+// a placeholder.  It is 1 so that compilers see no division by zero there.
+static void fail_value(char *val, const char *msg) {
+    emit_fail(msg);
+    strcpy(val, "1");
+}
+
+static void new_temp(char *val) { sprintf(val, "t%u", ntemps++); }
+
+// INT_MIN has no literal of type int.
+static void literal(char *val, int n) {
+    if (n >= 0) {
+        sprintf(val, "%d", n);
+    } else {
+        sprintf(val, "(-%d - 1)", -(n + 1));
+    }
+}
+
+static void depth_expr(char *buf, unsigned int dofs) {
+    depth_used = 1;
+    if (dofs == 0) {
+        strcpy(buf, "depth");
+    } else {
+        sprintf(buf, "depth + %u", dofs);
+    }
+}
+
+static local_t *push_local(const char *name) {
+    if (nlocals == EXPORT_LOCALS) return NULL;
+    local_t *l = &locals[nlocals++];
+    memcpy(l->name, name, 4);
+    l->used = 0;
+    return l;
+}
+
+static void pop_locals(size_t n) {
+    while (n-- > 0) {
+        local_t *l = &locals[--nlocals];
+        if (!l->used) {
+            emit("(void)%s;", l->val);
+        }
+    }
+}
+
+// ===========
+// expressions
+// ===========
+
+// gen writes the statements computing node and stores the operand holding
+// its value in val.  dofs is the depth of the calls made by node relative
+// to the body: the arguments of a call are evaluated inside it.
+static int gen(const symb_t *node, unsigned int dofs, char *val);
+
+static const char *binary_format(int type) {
+    switch (type) {
+        case ~RL_OR:
+            return "%s | %s";
+        case ~RL_XOR:
+            return "%s ^ %s";
+        case ~RL_AND:
+            return "%s & %s";
+        case ~RL_EQ:
+            return "%s == %s";
+        case ~RL_NEQ:
+            return "%s != %s";
+        case ~RL_LT:
+            return "%s < %s";
+        case ~RL_LEQ:
+            return "%s <= %s";
+        case ~RL_GT:
+            return "%s > %s";
+        case ~RL_GEQ:
+            return "%s >= %s";
+        case ~RL_LL:
+            return "(int32_t)((uint32_t)%s << (%s & 31))";
+        case ~RL_GG:
+            return "%s >> (%s & 31)";
+        case ~RL_GGG:
+            return "(int32_t)((uint32_t)%s >> (%s & 31))";
+        case ~RL_ADD:
+            return "(int32_t)((uint32_t)%s + (uint32_t)%s)";
+        case ~RL_SUB:
+            return "(int32_t)((uint32_t)%s - (uint32_t)%s)";
+        case ~RL_MUL:
+            return "(int32_t)((uint32_t)%s * (uint32_t)%s)";
+        default:
+            return NULL;
+    }
+}
+
+// The result of comparing a value with itself, or -1 if type is not a
+// comparison.
+static int self_compare(int type) {
+    switch (type) {
+        case ~RL_EQ:
+        case ~RL_LEQ:
+        case ~RL_GEQ:
+            return 1;
+        case ~RL_NEQ:
+        case ~RL_LT:
+        case ~RL_GT:
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+static int gen_name(const char *name, char *val) {
+    for (size_t i = nlocals; i-- > 0;) {
+        if (same_name(locals[i].name, name)) {
+            locals[i].used = 1;
+            strcpy(val, locals[i].val);
+            return 0;
+        }
+    }
+    var_entry_t *e = lookup_var(name);
+    if (e == NULL) {
+        fail_value(val, "undefined variable");
+        return 0;
+    }
+    if (e->fundef != NULL) {
+        fail_value(val, "using function as a number");
+        return 0;
+    }
+    size_t i = 0;
+    while (i < nglobals && !same_name(globals[i], name)) {
+        i++;
+    }
+    if (i == nglobals) {
+        memcpy(globals[nglobals++], name, 4);
+    }
+    sprintf(val, "%s_%.4s", prefix, name);
+    return 0;
+}
+
+// A divisor given as a number needs no checks at run time, unless it is 0
+// or -1.
+static int gen_div(const symb_t *node, unsigned int dofs, char *val) {
+    int div = node->type == ~RL_DIV;
+    char a[VAL_SIZE], b[VAL_SIZE];
+    if (gen(node->arg1, dofs, a) != 0 || gen(node->arg2, dofs, b) != 0)
+        return 1;
+    const symb_t *d = node->arg2;
+    while (d->type == ~RL_TERM_INT || d->type == ~RL_TERM_GROUP ||
+           d->type == ~RL_UPLUS) {
+        d = d->arg1;
+    }
+    if (d->type == TOK_NUM && d->token.num == 0) {
+        emit("(void)%s;", a);
+        fail_value(val, "division by zero");
+        return 0;
+    }
+    if (d->type != TOK_NUM) {
+        emit("if (%s == 0) return fail(\"%.4s\", \"division by zero\");", b,
+             cur_fn->name);
+    }
+    new_temp(val);
+    if (d->type == TOK_NUM && d->token.num != -1) {
+        emit(div ? "int32_t %s = %s / %s;" : "int32_t %s = %s %% %s;", val, a,
+             b);
+    } else if (d->type == TOK_NUM) {
+        emit(div ? "int32_t %s = (int32_t)(0u - (uint32_t)%s);"
+                 : "int32_t %s = 0;",
+             val, a);
+        if (!div) {
+            emit("(void)%s;", a);
+        }
+    } else if (div) {
+        emit("int32_t %s = %s == -1 ? (int32_t)(0u - (uint32_t)%s) : %s / %s;",
+             val, b, a, a, b);
+    } else {
+        emit("int32_t %s = %s == -1 ? 0 : %s %% %s;", val, b, a, b);
+    }
+    return 0;
+}
+
+static int gen_native(const builtin_t *b, const symb_t *arglist_opt,
+                      unsigned int dofs, char *val) {
+    char args[BUILTIN_MAX_ARGS][VAL_SIZE];
+    const symb_t *arg = arglist_opt->arg1;
+    for (int i = 0; i < b->nargs; i++) {
+        if (i > 0) {
+            arg = arg->arg2;
+        }
+        if (gen(arg->arg1, dofs, args[i]) != 0) return 1;
+    }
+    if (same_name(b->name, "pow")) {
+        emit("if (%s < 0) return fail(\"%.4s\", \"negative exponent\");",
+             args[1], cur_fn->name);
+    }
+    new_temp(val);
+    if (b->nargs == 1) {
+        emit("int32_t %s = bi_%.4s(%s);", val, b->name, args[0]);
+    } else {
+        emit("int32_t %s = bi_%.4s(%s, %s);", val, b->name, args[0], args[1]);
+    }
+    return 0;
+}
+
+static const symb_t *bound_name(const symb_t *arg) {
+    while (arg->type == ~RL_TERM_ID) {
+        arg = arg->arg1;
+    }
+    return arg;
+}
+
+// The loop of reduce, without the closed form of affine sums, which gives
+// the same value.
+static int gen_reduce(const builtin_t *b, const symb_t *arglist_opt,
+                      unsigned int dofs, char *val) {
+    const symb_t *args[6];
+    const symb_t *arg = arglist_opt->arg1;
+    for (int i = 0; i < b->nargs; i++) {
+        if (i > 0) {
+            arg = arg->arg2;
+        }
+        args[i] = arg->arg1;
+    }
+    char lo[VAL_SIZE], hi[VAL_SIZE], init[VAL_SIZE], acc[VAL_SIZE];
+    if (gen(args[1], dofs, lo) != 0 || gen(args[2], dofs, hi) != 0) return 1;
+    if (b->form == BUILTIN_FOLD && gen(args[4], dofs, init) != 0) return 1;
+    new_temp(acc);
+    if (b->form == BUILTIN_FOLD) {
+        emit("uint32_t %s = (uint32_t)%s;", acc, init);
+    } else {
+        emit("uint32_t %s = %s;", acc, b->form == BUILTIN_PROD ? "1" : "0");
+    }
+    emit("if (%s <= %s) {", lo, hi);
+    level++;
+    char m[VAL_SIZE], k[VAL_SIZE];
+    new_temp(m);
+    new_temp(k);
+    emit("uint32_t %s = (uint32_t)%s - (uint32_t)%s;", m, hi, lo);
+    emit("for (uint32_t %s = 0;; %s++) {", k, k);
+    level++;
+    // the variable comes first in the scope, then the accumulator
+    size_t nbound = 0;
+    if (b->form == BUILTIN_FOLD) {
+        local_t *a = push_local(bound_name(args[3])->token.idname);
+        if (a == NULL) EXPORT_DIE("too many names in a function to export");
+        nbound++;
+        new_temp(a->val);
+        emit("int32_t %s = (int32_t)%s;", a->val, acc);
+    }
+    local_t *iv = push_local(bound_name(args[0])->token.idname);
+    if (iv == NULL) EXPORT_DIE("too many names in a function to export");
+    nbound++;
+    new_temp(iv->val);
+    emit("int32_t %s = (int32_t)((uint32_t)%s + %s);", iv->val, lo, k);
+    char body[VAL_SIZE];
+    if (gen(args[b->nargs - 1], dofs, body) != 0) return 1;
+    switch (b->form) {
+        case BUILTIN_SUM:
+            emit("%s += (uint32_t)%s;", acc, body);
+            break;
+        case BUILTIN_PROD:
+            emit("%s *= (uint32_t)%s;", acc, body);
+            break;
+        default:
+            emit("%s = (uint32_t)%s;", acc, body);
+            break;
+    }
+    pop_locals(nbound);
+    emit("if (%s == %s) break;", k, m);
+    level--;
+    emit("}");
+    level--;
+    emit("}");
+    new_temp(val);
+    emit("int32_t %s = (int32_t)%s;", val, acc);
+    return 0;
+}
+
+// As in do_eval_ctx, the depth and the number of arguments are checked
+// before the arguments are evaluated.
+static int gen_call(const symb_t *node, unsigned int dofs, char *val) {
+    const char *name = node->arg1->token.idname;
+    const symb_t *arglist_opt = node->arg2;
+    const builtin_t *b = builtin_lookup(name);
+    if (b != NULL) {
+        if (b->form == BUILTIN_NATIVE) {
+            return gen_native(b, arglist_opt, dofs, val);
+        }
+        return gen_reduce(b, arglist_opt, dofs, val);
+    }
+    var_entry_t *e = lookup_var(name);
+    if (e == NULL) {
+        fail_value(val, "undefined function");
+        return 0;
+    }
+    if (e->fundef == NULL) {
+        fail_value(val, "using number as function");
+        return 0;
+    }
+    const export_fn_t *f = find_fn(name);
+    if (f == NULL) EXPORT_DIE("function to export not found");
+    char depth[VAL_SIZE];
+    depth_expr(depth, dofs);
+    emit("if (%s == %d) return fail(\"%.4s\", \"recursion too deep\");", depth,
+         CALC_CALL_DEPTH, cur_fn->name);
+    size_t argc = 0;
+    const symb_t *arg = NULL;
+    if (arglist_opt->type == ~RL_ARGLIST_OPT_1) {
+        argc = 1;
+        for (arg = arglist_opt->arg1; arg->type == ~RL_ARGLIST_CONS;
+             arg = arg->arg2) {
+            argc++;
+        }
+    }
+    if (argc != f->nparams) {
+        fail_value(val, "wrong number of arguments");
+        return 0;
+    }
+    char args[argc + 1][VAL_SIZE];
+    arg = argc > 0 ? arglist_opt->arg1 : NULL;
+    for (size_t i = 0; i < argc; i++, arg = arg->arg2) {
+        if (gen(arg->arg1, dofs + 1, args[i]) != 0) return 1;
+    }
+    new_temp(val);
+    depth_expr(depth, dofs + 1);
+    // set on every path, but compilers cannot tell through the call
+    emit("int32_t %s = 0;", val);
+    fprintf(out, "%*sif (f_%.4s(&%s, %s", 4 * level, "", f->name, val, depth);
+    for (size_t i = 0; i < argc; i++) {
+        fprintf(out, ", %s", args[i]);
+    }
+    fprintf(out, ") != 0) return 1;\n");
+    return 0;
+}
+
+static int gen(const symb_t *node, unsigned int dofs, char *val) {
+    switch (node->type) {
+        case TOK_NUM:
+            literal(val, node->token.num);
+            return 0;
+        case TOK_ID:
+            return gen_name(node->token.idname, val);
+        case ~RL_DIV:
+        case ~RL_MOD:
+            return gen_div(node, dofs, val);
+        case ~RL_NOT:
+        case ~RL_UMINUS: {
+            char a[VAL_SIZE];
+            if (gen(node->arg1, dofs, a) != 0) return 1;
+            new_temp(val);
+            emit(node->type == ~RL_NOT
+                     ? "int32_t %s = ~%s;"
+                     : "int32_t %s = (int32_t)(0u - (uint32_t)%s);",
+                 val, a);
+            return 0;
+        }
+        case ~RL_UPLUS:
+        case ~RL_STMT_EXPR:
+        case ~RL_TERM_INT:
+        case ~RL_TERM_ID:
+        case ~RL_TERM_GROUP:
+            return gen(node->arg1, dofs, val);
+        case ~RL_FUNCALL:
+            return gen_call(node, dofs, val);
+        default: {
+            const char *format = binary_format(node->type);
+            if (format == NULL) EXPORT_DIE("cannot export expression");
+            char a[VAL_SIZE], b[VAL_SIZE], expr[4 * VAL_SIZE];
+            if (gen(node->arg1, dofs, a) != 0 || gen(node->arg2, dofs, b) != 0)
+                return 1;
+            // operands are names or literals, and compilers warn when one is
+            // compared with itself
+            int self = strcmp(a, b) == 0 ? self_compare(node->type) : -1;
+            if (self >= 0) {
+                if (a[0] != '(' && (a[0] < '0' || a[0] > '9')) {
+                    emit("(void)%s;", a);  // a name, which may be unused
+                }
+                literal(val, self);
+                return 0;
+            }
+            snprintf(expr, sizeof(expr), format, a, b);
+            new_temp(val);
+            emit("int32_t %s = %s;", val, expr);
+            return 0;
+        }
+    }
+}
+
+// =========
+// functions
+// =========
+
+static void write_params(const export_fn_t *f) {
+    for (size_t i = 0; i < f->nparams; i++) {
+        fprintf(out, ", int32_t p%zu", i);
+    }
+}
+
+// Writes f's definition as a static function taking the call depth, which
+// is 1 in a call made by the program.
+static int write_body(const export_fn_t *f) {
+    symb_t *mark = get_slr_mem_mark();
+    var_entry_t scope[f->nparams + 1];
+    symb_t *body;
+    size_t nparams;
+    if (parse_fundef(&body, &nparams, scope, f->nparams, f->fundef) != 0) {
+        release_slr_mem(mark);
+        return 1;
+    }
+    cur_fn = f;
+    nlocals = 0;
+    ntemps = 0;
+    depth_used = 0;
+    level = 1;
+    // the first of two parameters of the same name is the one seen
+    for (size_t i = f->nparams; i-- > 0;) {
+        local_t *p = push_local(scope[i].name);
+        if (p == NULL) {
+            release_slr_mem(mark);
+            EXPORT_DIE("too many names in a function to export");
+        }
+        sprintf(p->val, "p%zu", i);
+    }
+    fprintf(out, "\nstatic int f_%.4s(int32_t *result, unsigned int depth",
+            f->name);
+    write_params(f);
+    fprintf(out, ") {\n");
+    char val[VAL_SIZE];
+    int ret = gen(body, 0, val);
+    release_slr_mem(mark);
+    if (ret != 0) return 1;
+    pop_locals(nlocals);
+    if (!depth_used) {
+        emit("(void)depth;");
+    }
+    emit("*result = %s;", val);
+    emit("return 0;");
+    fprintf(out, "}\n");
+    return 0;
+}
+
+// The definition as a comment, on one line.
+static void write_fundef(const export_fn_t *f) {
+    fprintf(out, "// ");
+    for (const char *p = f->fundef; *p != '\0'; p++) {
+        if (*p != '\n' && *p != '\r') {
+            fputc(*p == '\t' ? ' ' : *p, out);
+        }
+    }
+    fputc('\n', out);
+}
+
+static void write_decl(const export_fn_t *f) {
+    fprintf(out, "int %s_%.4s(int32_t *result", prefix, f->name);
+    write_params(f);
+    fprintf(out, ")");
+}
+
+// =======
+// sources
+// =======
+
+// the built-in functions as builtin.c has them
+static const char *const builtin_code =
+    "static inline int32_t bi_pow(int32_t b, int32_t e) {\n"
+    "    uint32_t x = (uint32_t)b, r = 1;\n"
+    "    for (uint32_t n = (uint32_t)e; n != 0; n >>= 1) {\n"
+    "        if (n & 1) r *= x;\n"
+    "        x *= x;\n"
+    "    }\n"
+    "    return (int32_t)r;\n"
+    "}\n"
+    "\n"
+    "static inline int32_t bi_min(int32_t a, int32_t b) {\n"
+    "    return a < b ? a : b;\n"
+    "}\n"
+    "\n"
+    "static inline int32_t bi_max(int32_t a, int32_t b) {\n"
+    "    return a > b ? a : b;\n"
+    "}\n"
+    "\n"
+    "static inline uint32_t magnitude(int32_t x) {\n"
+    "    return x < 0 ? 0u - (uint32_t)x : (uint32_t)x;\n"
+    "}\n"
+    "\n"
+    "static inline int32_t bi_abs(int32_t x) {\n"
+    "    return (int32_t)magnitude(x);\n"
+    "}\n"
+    "\n"
+    "static inline int32_t bi_popc(int32_t v) {\n"
+    "    uint32_t x = (uint32_t)v;\n"
+    "    x = x - (x >> 1 & 0x55555555u);\n"
+    "    x = (x & 0x33333333u) + (x >> 2 & 0x33333333u);\n"
+    "    x = (x + (x >> 4)) & 0x0f0f0f0fu;\n"
+    "    return (int32_t)(x * 0x01010101u >> 24);\n"
+    "}\n"
+    "\n"
+    "static inline int32_t bi_clz(int32_t v) {\n"
+    "    uint32_t x = (uint32_t)v;\n"
+    "    if (x == 0) return 32;\n"
+    "    int32_t n = 0;\n"
+    "    for (int s = 16; s > 0; s >>= 1) {\n"
+    "        if (x >> (32 - s) == 0) {\n"
+    "            n += s;\n"
+    "            x <<= s;\n"
+    "        }\n"
+    "    }\n"
+    "    return n;\n"
+    "}\n"
+    "\n"
+    "static inline int32_t bi_ctz(int32_t v) {\n"
+    "    uint32_t x = (uint32_t)v;\n"
+    "    return x == 0 ? 32 : bi_popc((int32_t)((x & (0u - x)) - 1));\n"
+    "}\n"
+    "\n"
+    "static inline int32_t bi_gcd(int32_t a0, int32_t b0) {\n"
+    "    uint32_t a = magnitude(a0), b = magnitude(b0);\n"
+    "    if (a == 0 || b == 0) return (int32_t)(a | b);\n"
+    "    int32_t shift = bi_ctz((int32_t)(a | b));\n"
+    "    a >>= bi_ctz((int32_t)a);\n"
+    "    do {\n"
+    "        b >>= bi_ctz((int32_t)b);\n"
+    "        if (a > b) {\n"
+    "            uint32_t t = a;\n"
+    "            a = b;\n"
+    "            b = t;\n"
+    "        }\n"
+    "        b -= a;\n"
+    "    } while (b != 0);\n"
+    "    return (int32_t)(a << shift);\n"
+    "}\n"
+    "\n"
+    "static inline int32_t bi_rotl(int32_t v, int32_t c) {\n"
+    "    uint32_t x = (uint32_t)v;\n"
+    "    unsigned int n = (unsigned int)c & 31;\n"
+    "    return (int32_t)(x << n | x >> (-n & 31));\n"
+    "}\n"
+    "\n"
+    "static inline int32_t bi_rotr(int32_t v, int32_t c) {\n"
+    "    uint32_t x = (uint32_t)v;\n"
+    "    unsigned int n = (unsigned int)c & 31;\n"
+    "    return (int32_t)(x >> n | x << (-n & 31));\n"
+    "}\n";
+
+static int write_source(const calc_limits_t *limits) {
+    fprintf(out,
+            "/*\n"
+            " * %s.c, written by mincalc :export\n"
+            " */\n"
+            "\n"
+            "#include <stddef.h>\n"
+            "\n"
+            "#include \"%s.h\"\n"
+            "\n"
+            "void (*%s_error_hook)(const char *func, const char *msg);\n"
+            "\n"
+            "static inline int fail(const char *func, const char *msg) {\n"
+            "    if (%s_error_hook != NULL) {\n"
+            "        %s_error_hook(func, msg);\n"
+            "    }\n"
+            "    return 1;\n"
+            "}\n"
+            "\n"
+            "%s\n",
+            prefix, prefix, prefix, prefix, prefix, builtin_code);
+    for (size_t i = 0; i < nfns; i++) {
+        fprintf(out, "static int f_%.4s(int32_t *result, unsigned int depth",
+                fns[i].name);
+        write_params(&fns[i]);
+        fprintf(out, ");\n");
+    }
+    for (size_t i = 0; i < nfns; i++) {
+        if (write_body(&fns[i]) != 0) return 1;
+    }
+    for (size_t i = 0; i < nfns; i++) {
+        fputc('\n', out);
+        write_decl(&fns[i]);
+        fprintf(out, " {\n    return f_%.4s(result, 1", fns[i].name);
+        for (size_t j = 0; j < fns[i].nparams; j++) {
+            fprintf(out, ", p%zu", j);
+        }
+        fprintf(out, ");\n}\n");
+    }
+    if (nglobals > 0) {
+        fputc('\n', out);
+    }
+    calc_start_statement(limits);
+    for (size_t i = 0; i < nglobals; i++) {
+        symb_t id;
+        id.token.type = TOK_ID;
+        memcpy(id.token.idname, globals[i], 4);
+        int n;
+        if (do_eval(&n, &id) != 0) return 1;
+        char val[VAL_SIZE];
+        literal(val, n);
+        fprintf(out, "int32_t %s_%.4s = %s;\n", prefix, globals[i], val);
+    }
+    return 0;
+}
+
+static void write_header(void) {
+    char guard[EXPORT_NAME_MAX + 1];
+    size_t i;
+    for (i = 0; prefix[i] != '\0'; i++) {
+        char c = prefix[i];
+        guard[i] = c >= 'a' && c <= 'z' ? (char)(c - 'a' + 'A') : c;
+    }
+    guard[i] = '\0';
+    fprintf(out,
+            "/*\n"
+            " * %s.h, written by mincalc :export\n"
+            " */\n"
+            "\n"
+            "#ifndef %s_H\n"
+            "#define %s_H\n"
+            "\n"
+            "#include <stdint.h>\n"
+            "\n"
+            "// Each function stores its value in *result and returns 0, or\n"
+            "// returns 1 where mincalc reports an error, after calling\n"
+            "// %s_error_hook, unless it is NULL, with the name of the\n"
+            "// function that failed and the message of mincalc, such as\n"
+            "// \"division by zero\".  Integers wrap around in 32 bits.\n"
+            "extern void (*%s_error_hook)(const char *func,\n"
+            "                             const char *msg);\n",
+            prefix, guard, guard, prefix, prefix);
+    if (nglobals > 0) {
+        fprintf(out, "\n// the variables the functions read, as exported\n");
+    }
+    for (size_t j = 0; j < nglobals; j++) {
+        fprintf(out, "extern int32_t %s_%.4s;\n", prefix, globals[j]);
+    }
+    for (size_t j = 0; j < nfns; j++) {
+        fputc('\n', out);
+        write_fundef(&fns[j]);
+        write_decl(&fns[j]);
+        fprintf(out, ";\n");
+    }
+    fprintf(out, "\n#endif /* %s_H */\n", guard);
+}
+
+// The prefix is the base name of path, which must be a C identifier.
+static int set_prefix(const char *path) {
+    const char *name = strrchr(path, '/');
+    name = name == NULL ? path : name + 1;
+    size_t len = strlen(name);
+    if (len == 0 || len > EXPORT_NAME_MAX || (name[0] >= '0' && name[0] <= '9'))
+        EXPORT_DIE("export name is not a C identifier");
+    for (size_t i = 0; i < len; i++) {
+        char c = name[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+              (c >= '0' && c <= '9') || c == '_'))
+            EXPORT_DIE("export name is not a C identifier");
+    }
+    strcpy(prefix, name);
+    return 0;
+}
+
+static int write_error(void) { EXPORT_DIE("cannot write export"); }
+
+int export_c(const char *path, const calc_limits_t *limits) {
+    if (set_prefix(path) != 0) return 1;
+    size_t len = strlen(path);
+    char source[len + 3], header[len + 3];
+    sprintf(source, "%s.c", path);
+    sprintf(header, "%s.h", path);
+
+    nfns = 0;
+    nglobals = 0;
+    if (collect_fns(calc_env->vars) != 0) return 1;
+    if (calc_env->base != NULL && collect_fns(calc_env->base->vars) != 0)
+        return 1;
+    qsort(fns, nfns, sizeof(fns[0]), by_name);
+
+    if ((out = fopen(source, "w")) == NULL) return write_error();
+    int ret = write_source(limits);
+    if (fclose(out) != 0 && ret == 0) {
+        ret = write_error();
+    }
+    if (ret == 0) {
+        if ((out = fopen(header, "w")) == NULL) {
+            ret = write_error();
+        } else {
+            write_header();
+            if (fclose(out) != 0) {
+                ret = write_error();
+            }
+        }
+    }
+    if (ret != 0) {
+        remove(source);
+        remove(header);
+    }
+    return ret;
+}
+
+#endif
@@ -0,0 +1,15 @@
+/*
+ * export.h
+ */
+
+#ifndef MINCALC_EXPORT_H
+#define MINCALC_EXPORT_H
+
+#include "calc.h"
+
+// Translates the functions of calc_env into C, written to path.c and
+// path.h; see export.c for what they contain.  The values of the globals
+// they read are evaluated within limits.  Host only.
+int export_c(const char *path, const calc_limits_t *limits);
+
+#endif /* MINCALC_EXPORT_H */
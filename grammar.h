@@ -0,0 +1,70 @@
+/*
+ * grammar.h
+ *
+ * Generated by slrgen from mincalc.grammar. Do not edit.
+ */
+
+#ifndef MINCALC_GRAMMAR_H
+#define MINCALC_GRAMMAR_H
+
+#include "lexer.h"
+
+enum nonterminal {
+    NT_STMT = NTOKTYPE,
+    NT_SETVAR,
+    NT_ASSIGN,
+    NT_FUNDEF,
+    NT_BIND,
+    NT_EXPR,
+    NT_IDLIST_OPT,
+    NT_IDLIST,
+    NT_ARGLIST_OPT,
+    NT_ARGLIST,
+};
+#define NSYMBOL (NT_ARGLIST + 1)
+
+enum grules {
+    RL_STMT_SETVAR,
+    RL_STMT_EXPR,
+    RL_SETVAR_ASSIGN,
+    RL_SETVAR_FUNDEF,
+    RL_SETVAR_BIND,
+    RL_ASSIGN,
+    RL_FUNDEF,
+    RL_BIND,
+    RL_OR,
+    RL_XOR,
+    RL_AND,
+    RL_EQ,
+    RL_NEQ,
+    RL_LT,
+    RL_LEQ,
+    RL_GT,
+    RL_GEQ,
+    RL_LL,
+    RL_GG,
+    RL_GGG,
+    RL_ADD,
+    RL_SUB,
+    RL_MUL,
+    RL_DIV,
+    RL_MOD,
+    RL_NOT,
+    RL_UPLUS,
+    RL_UMINUS,
+    RL_TERM_INT,
+    RL_TERM_ID,
+    RL_TERM_GROUP,
+    RL_FUNCALL,
+    RL_IDLIST_OPT_0,
+    RL_IDLIST_OPT_1,
+    RL_IDLIST,
+    RL_IDLIST_CONS,
+    RL_ARGLIST_OPT_0,
+    RL_ARGLIST_OPT_1,
+    RL_ARGLIST,
+    RL_ARGLIST_CONS,
+};
+#define NRULES (RL_ARGLIST_CONS + 1)
+
+#endif /* MINCALC_GRAMMAR_H */
@@ -2,7 +2,10 @@
  * io.c
  */
 
+#include <stddef.h>
+
 #include "io.h"
+#include "uart.h"
 
 // ========
 // byte I/O
@@ -10,6 +13,17 @@
 
 #ifdef __FPGA_EXP__
 
+#ifdef MINCALC_UART_RING
+
+int mc_putchar(int c) {
+    uart_putc(c);
+    return c;
+}
+
+int mc_getchar(void) { return uart_getc(); }
+
+#else
+
 #include <uart_sendrecv.h>
 
 int mc_putchar(int c) {
@@ -23,24 +37,66 @@ int mc_getchar(void) {
     return c;
 }
 
+#endif /* MINCALC_UART_RING */
+
 #else
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int (*output)(int c);
+
+// Sends the output of mc_putchar to put instead of stdout, or back to stdout
+// if put is NULL.
+void mc_set_output(int (*put)(int c)) { output = put; }
+
+#ifdef MINCALC_UART_SIM
+
+int mc_putchar(int c) {
+    if (output != NULL) {
+        return output(c);
+    }
+    uart_putc(c);
+    return c;
+}
+
+int mc_getchar(void) { return uart_getc(); }
+
+#else
+
+int mc_putchar(int c) { return output != NULL ? output(c) : putchar(c); }
+
+// Input is read in blocks, and output is flushed only before waiting for
+// more input, so all the lines of a block are answered with one write.
+static unsigned char in_buf[4096];
+static size_t in_pos;
+static size_t in_len;
 
-int mc_putchar(int c) { return putchar(c); }
 int mc_getchar(void) {
-    int c;
-    if ((c = getchar()) == EOF) {
-        if (feof(stdin)) {
-            exit(0);
-        } else {
-            exit(1);
+    if (in_pos == in_len) {
+        fflush(stdout);
+        ssize_t n;
+        do {
+            n = read(STDIN_FILENO, in_buf, sizeof(in_buf));
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+            exit(n == 0 ? 0 : 1);
         }
+        in_pos = 0;
+        in_len = (size_t)n;
     }
-    return c;
+    return in_buf[in_pos++];
 }
 
+#endif /* MINCALC_UART_SIM */
+
 #endif
 
 // ====================
@@ -81,3 +137,112 @@ char *mc_getsn(char *str, int len) {
     str[i] = '\0';
     return str;
 }
+
+// ======
+// errors
+// ======
+
+static int collecting;
+static const char *err_category;
+static const char *err_msg;
+
+void mc_error(const char *category, const char *msg) {
+    if (collecting) {
+        if (err_msg == NULL) {
+            err_category = category;
+            err_msg = msg;
+        }
+        return;
+    }
+    mc_print(category);
+    mc_print(" ERR: ");
+    mc_puts(msg);
+}
+
+void mc_collect_errors(int on) {
+    collecting = on;
+    err_msg = NULL;
+}
+
+const char *mc_collected_error(const char **category) {
+    *category = err_category;
+    return err_msg;
+}
+
+// ==========
+// host files
+// ==========
+
+#ifndef __FPGA_EXP__
+
+// Reads the whole file at path with one read.  Returns its size, or -1 if it
+// cannot be read or is larger than size.
+long mc_read_file(const char *path, void *buf, unsigned long size) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return -1;
+    }
+    size_t n = fread(buf, 1, size, f);
+    int too_long = n == size && fgetc(f) != EOF;
+    int err = ferror(f);
+    fclose(f);
+    if (too_long || err) {
+        return -1;
+    }
+    return (long)n;
+}
+
+int mc_write_file(const char *path, const void *buf, unsigned long size) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return 1;
+    }
+    int err = fwrite(buf, 1, size, f) != size;
+    if (fclose(f) != 0) {
+        err = 1;
+    }
+    return err;
+}
+
+// Writes a new file and renames it to path, so that a process reading or
+// mapping path sees either the old contents or the new ones.
+int mc_replace_file(const char *path, const void *buf, unsigned long size) {
+    size_t len = strlen(path);
+    char tmp[len + 24];
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+    if (mc_write_file(tmp, buf, size) != 0) {
+        remove(tmp);
+        return 1;
+    }
+    if (rename(tmp, path) != 0) {
+        remove(tmp);
+        return 1;
+    }
+    return 0;
+}
+
+// Maps the whole file at path read-only and shared, for the life of the
+// process.  Returns its address and stores its size, or returns NULL.
+const void *mc_map_file(const char *path, unsigned long *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    *size = (unsigned long)st.st_size;
+    return p;
+}
+
+void mc_unmap_file(const void *buf, unsigned long size) {
+    munmap((void *)(uintptr_t)buf, (size_t)size);
+}
+
+#endif
@@ -13,4 +13,22 @@ int mc_print(const char *s);
 int mc_puts(const char *s);
 char *mc_getsn(char *str, int len);
 
+// Reports an error as "CATEGORY ERR: msg", or only records it while errors
+// are collected.
+void mc_error(const char *category, const char *msg);
+// Starts or stops collecting errors; either forgets the recorded one.
+void mc_collect_errors(int on);
+// Returns the first error collected, or NULL, and stores its category.
+const char *mc_collected_error(const char **category);
+
+#ifndef __FPGA_EXP__
+void mc_set_output(int (*put)(int c));
+
+long mc_read_file(const char *path, void *buf, unsigned long size);
+int mc_write_file(const char *path, const void *buf, unsigned long size);
+int mc_replace_file(const char *path, const void *buf, unsigned long size);
+const void *mc_map_file(const char *path, unsigned long *size);
+void mc_unmap_file(const void *buf, unsigned long size);
+#endif
+
 #endif /* MINCALC_IO_H */
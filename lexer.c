@@ -3,27 +3,53 @@
  */
 
 #include "io.h"
+#include "stats.h"
 #include "strutils.h"
 
 #include "lexer.h"
 
 #define LEX_DIE(msg)                \
     do {                            \
-        mc_puts("LEXER ERR: " msg); \
+        mc_error("LEXER", msg);     \
+        STAT_ERROR(STAT_ERR_LEXER); \
         return 1;                   \
     } while (0)
 
+// Reads a literal in base 1 << shift after its 0x, 0o or 0b prefix, which
+// *str points to.
+static int get_radix_num(token_t *tok, const char **str, int shift) {
+    static const unsigned char max_digits[5] = {0, 32, 0, 11, 8};
+    const char *start = (*str += 2);
+    size_t len = 0;
+    while (mc_digit_value(**str) < (1u << shift)) {
+        ++*str;
+        len++;
+    }
+    if (len == 0) LEX_DIE("expected digits");
+    if (len > max_digits[shift] || (shift == 3 && len == 11 && *start > '3'))
+        LEX_DIE("number literal too long");
+    tok->type = TOK_NUM;
+    tok->num = mc_atoi_radix(start, len, shift);
+    return 0;
+}
+
 int get_next_tok(token_t *tok, const char **str) {
-    static char buf[11];
     char c = **str;
     while (c == ' ' || c == '\n') {
         c = *(++*str);
     }
+    if (c == '0') {
+        c = (*str)[1];
+        if (c == 'x') return get_radix_num(tok, str, 4);
+        if (c == 'o') return get_radix_num(tok, str, 3);
+        if (c == 'b') return get_radix_num(tok, str, 1);
+        c = '0';
+    }
     if ('0' <= c && c <= '9') {
+        const char *start = *str;
         int ok = 0;
         int i;
         for (i = 0; i < 10; i++) {
-            buf[i] = c;
             c = *(++*str);
             if (!('0' <= c && c <= '9')) {
                 ok = 1;
@@ -31,9 +57,8 @@ int get_next_tok(token_t *tok, const char **str) {
             }
         }
         if (!ok) LEX_DIE("number literal too long");
-        buf[++i] = '\0';
         tok->type = TOK_NUM;
-        tok->num = mc_atoi(buf);
+        tok->num = mc_atoi_n(start, (size_t)(i + 1));
     } else if ('a' <= c && c <= 'z') {
         int ok = 0;
         tok->type = TOK_ID;
@@ -53,9 +78,13 @@ int get_next_tok(token_t *tok, const char **str) {
     } else {
         switch (c) {
             case ':':
-                if (*(++*str) == '=') {
+                c = *(++*str);
+                if (c == '=') {
                     ++*str;
                     tok->type = TOK_DEFEQ;
+                } else if (c == ':' && *(++*str) == '=') {
+                    ++*str;
+                    tok->type = TOK_BINDEQ;
                 } else
                     LEX_DIE("expected '='");
                 break;
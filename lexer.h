@@ -10,6 +10,7 @@ enum toktype {
     TOK_NUM,
     TOK_ID,
     TOK_DEFEQ,
+    TOK_BINDEQ,
     TOK_LPAR,
     TOK_RPAR,
     TOK_COMMA,
@@ -4,75 +4,125 @@
 
 #include "calc.h"
 #include "io.h"
-#include "lexer.h"
-#include "parser.h"
-#include "strutils.h"
+#include "session.h"
+
+#ifndef __FPGA_EXP__
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "server.h"
+#include "stats.h"
+#endif
 
 #define BUFSIZE 1024
 
-static void show_caret(size_t pos) {
-    while (pos-- > 0) {
-        mc_putchar(' ');
+static char buf[BUFSIZE];
+static session_t console;
+
+#ifndef __FPGA_EXP__
+static const char *server_path;
+static int loaded;
+static int timed;  // -t was given
+static volatile sig_atomic_t running;  // a line, not waiting for input
+
+// Ctrl-C cancels the statement being evaluated and returns to the prompt;
+// at the prompt it ends the program as before.
+static void on_sigint(int sig) {
+    if (!running) {
+        signal(sig, SIG_DFL);
+        raise(sig);
+        return;
     }
-    mc_putchar('^');
-    mc_putchar('\n');
+    calc_interrupt();
 }
 
-static char buf[BUFSIZE];
+static int parse_limit(unsigned long *limit, const char *arg) {
+    char *end;
+    *limit = strtoul(arg, &end, 10);
+    return *arg < '0' || *arg > '9' || *end != '\0';
+}
 
-int main() {
-    while (1) {
-        mc_putchar('>');
-        mc_getsn(buf, BUFSIZE);
-        int is_svar;
-        if (mc_strstr(buf, ":=") != NULL) {
-            is_svar = 1;
-            init_slr_svar();
-        } else {
-            is_svar = 0;
-            init_slr_expr();
+static int parse_args(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            if (stats_write_at_exit(argv[++i]) != 0) return 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            if (session_load(&console, argv[++i]) != 0) return 1;
+            loaded = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-L") == 0 && i + 1 < argc) {
+            if (session_attach(&console, argv[++i]) != 0) return 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-p") == 0) {
+            console.proto = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+            server_path = argv[++i];
+            continue;
         }
-        token_t tok;
-        const char *bufptr = buf;
-        int is_empty = 1;
-        while (1) {
-            if (get_next_tok(&tok, &bufptr) != 0) {
-                mc_print(buf);
-                show_caret((size_t)(bufptr - buf));
-                break;
-            }
-            if (tok.type == TOK_EOS && is_empty) {
-                break;
-            }
-            is_empty = 0;
-            if (slr_feed_token(&tok) != 0) {
-                mc_print(buf);
-                show_caret((size_t)(bufptr - buf));
-                break;
-            }
-            if (tok.type == TOK_EOS) {
-                symb_t *symb = slr_get_result();
-                if (symb == NULL) {
-                    mc_puts("internal error");
-                    break;
-                }
-                if (is_svar) {
-                    if (do_svar(symb, buf) != 0) {
-                        // error
-                        break;
-                    }
-                } else {
-                    int ans;
-                    if (do_eval(&ans, symb) != 0) {
-                        // error
-                        break;
-                    }
-                    print_int(ans);
-                    mc_putchar('\n');
-                }
-                break;
-            }
+        if (strcmp(argv[i], "-b") == 0 && i + 1 < argc &&
+            parse_limit(&console.limits.nodes, argv[++i]) == 0) {
+            continue;
         }
-        clear_slr_mem();
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc &&
+            parse_limit(&console.limits.ms, argv[++i]) == 0) {
+            timed = 1;
+            continue;
+        }
+        mc_puts("usage: mincalc [-p] [-s STATS_FILE] [-l SNAPSHOT] "
+                "[-L LIBRARY] [-S SOCKET] [-b NODES] [-t MS]");
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+int main(int argc, char **argv) {
+    session_init(&console, calc_env);
+#ifndef __FPGA_EXP__
+    if (parse_args(argc, argv) != 0) {
+        return 1;
+    }
+    if (server_path != NULL) {
+        // what was loaded with -l, or else the library mapped with -L, is
+        // shared read-only by all connections
+        const calc_env_t *base = console.env->base;
+        if (loaded && calc_env_freeze(console.env) != 0) {
+            return 1;
+        }
+        if (loaded) {
+            base = console.env;
+        }
+        if (!timed) {
+            console.limits.ms = SERVER_TIMEOUT_MS;
+        }
+        return server_run(server_path, base, console.proto,
+                          &console.limits);
+    }
+    struct sigaction sa = {.sa_handler = on_sigint};
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+#else
+    (void)argc;
+    (void)argv;
+#endif
+    while (1) {
+        if (!console.proto) {
+            mc_putchar('>');
+        }
+        mc_getsn(buf, BUFSIZE);
+#ifndef __FPGA_EXP__
+        running = 1;
+        session_line(&console, buf);
+        running = 0;
+#else
+        session_line(&console, buf);
+#endif
     }
 }
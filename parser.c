@@ -2,7 +2,9 @@
  * parser.c
  */
 
+#include "builtin.h"
 #include "io.h"
+#include "stats.h"
 #include "strutils.h"
 
 #include "parser.h"
@@ -12,10 +14,15 @@
 mincalc grammar
 ===============
 
+The levels expr1 ... expr8 below are written in mincalc.grammar as a single
+expression nonterminal with precedence declarations; both describe the same
+language.
+
 statement ::= set-variable | expression
-set-variable ::= assignment | function-definition
+set-variable ::= assignment | function-definition | binding
 assignment ::= identifier ":=" expression
 function-definition ::= identifier "(" identifier-list-opt ")" ":=" expression
+binding ::= identifier "::=" expression
 expression ::= expr1 | expression "|" expr1
 expr1 ::= expr2 | expr1 "^" expr2
 expr2 ::= expr3 | expr2 "&" expr3
@@ -46,513 +53,171 @@ digit ::= "0" | "1" | "2" | "3" | "4" | "5" | "6" | "7" | "8" | "9"
 
 */
 
-static const signed char slr_table[][NSYMBOL] = {
-    {0},
-
-    {0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     //
-     0, 80, 2, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_SETVAR_ASSIGN, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_SETVAR_FUNDEF, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 0, 0, 5, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 6, 30, 33, 36, 41, 50, 57, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {~RL_ASSIGN, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 28, 0, 0, 0, 0, 0, 0, 0, 0,
-     0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 0, 9, 0, 0, ~RL_IDLIST_OPT_0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 12, 8, 0, 0},
-
-    {0, 0, 0, 0, 0, ~RL_IDLIST_OPT_1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 0, 0, 0, 0, ~RL_IDLIST, 10, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 0, 9, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 11, 0, 0},
-
-    {0, 0, 0, 0, 0, ~RL_IDLIST_CONS, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 0, 0, 0, 0, 13, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 0, 0, 14, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 15, 30, 33, 36, 41, 50, 57, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {~RL_FUNDEF, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 28, 0, 0, 0, 0, 0, 0, 0, 0,
-     0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 27, 30, 33, 36, 41, 50, 57, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {~RL_TERM_INT, 0, 0, 0, 0, ~RL_TERM_INT, ~RL_TERM_INT, ~RL_TERM_INT,
-     ~RL_TERM_INT, ~RL_TERM_INT, ~RL_TERM_INT, ~RL_TERM_INT, ~RL_TERM_INT,
-     ~RL_TERM_INT, ~RL_TERM_INT, 0, ~RL_TERM_INT, ~RL_TERM_INT, ~RL_TERM_INT,
-     ~RL_TERM_INT, ~RL_TERM_INT, ~RL_TERM_INT, ~RL_TERM_INT, ~RL_TERM_INT,
-     ~RL_TERM_INT,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_TERM_FUNCALL, 0, 0, 0, 0, ~RL_TERM_FUNCALL, ~RL_TERM_FUNCALL,
-     ~RL_TERM_FUNCALL, ~RL_TERM_FUNCALL, ~RL_TERM_FUNCALL, ~RL_TERM_FUNCALL,
-     ~RL_TERM_FUNCALL, ~RL_TERM_FUNCALL, ~RL_TERM_FUNCALL, ~RL_TERM_FUNCALL, 0,
-     ~RL_TERM_FUNCALL, ~RL_TERM_FUNCALL, ~RL_TERM_FUNCALL, ~RL_TERM_FUNCALL,
-     ~RL_TERM_FUNCALL, ~RL_TERM_FUNCALL, ~RL_TERM_FUNCALL, ~RL_TERM_FUNCALL,
-     ~RL_TERM_FUNCALL,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_TERM_ID, 0, 0, 0, 20, ~RL_TERM_ID, ~RL_TERM_ID, ~RL_TERM_ID,
-     ~RL_TERM_ID, ~RL_TERM_ID, ~RL_TERM_ID, ~RL_TERM_ID, ~RL_TERM_ID,
-     ~RL_TERM_ID, ~RL_TERM_ID, 0, ~RL_TERM_ID, ~RL_TERM_ID, ~RL_TERM_ID,
-     ~RL_TERM_ID, ~RL_TERM_ID, ~RL_TERM_ID, ~RL_TERM_ID, ~RL_TERM_ID,
-     ~RL_TERM_ID,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, ~RL_ARGLIST_OPT_0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0,
-     0, 0, 0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 24, 30, 33, 36, 41, 50, 57, 62, 69, 70, 18, 0, 0, 21, 23},
-
-    {0, 0, 0, 0, 0, 22, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_FUNCALL, 0, 0, 0, 0, ~RL_FUNCALL, ~RL_FUNCALL, ~RL_FUNCALL,
-     ~RL_FUNCALL, ~RL_FUNCALL, ~RL_FUNCALL, ~RL_FUNCALL, ~RL_FUNCALL,
-     ~RL_FUNCALL, ~RL_FUNCALL, 0, ~RL_FUNCALL, ~RL_FUNCALL, ~RL_FUNCALL,
-     ~RL_FUNCALL, ~RL_FUNCALL, ~RL_FUNCALL, ~RL_FUNCALL, ~RL_FUNCALL,
-     ~RL_FUNCALL,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 0, 0, 0, 0, ~RL_ARGLIST_OPT_1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 0, 0, 0, 0, ~RL_ARGLIST, 25, 0, 0, 0, 0, 0, 0, 28, 0, 0, 0, 0, 0, 0, 0,
-     0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 24, 30, 33, 36, 41, 50, 57, 62, 69, 70, 18, 0, 0, 0, 26},
-
-    {0, 0, 0, 0, 0, ~RL_ARGLIST_CONS, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_STMT_EXPR, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 28, 0, 0, 0, 0, 0, 0, 0,
-     0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 29, 33, 36, 41, 50, 57, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {~RL_OR, 0, 0, 0, 0, ~RL_OR, ~RL_OR, 0, 0, 0, 0, 0, 0, ~RL_OR, 31, 0, 0, 0,
-     0, 0, 0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_EXPR_OR, 0, 0, 0, 0, ~RL_EXPR_OR, ~RL_EXPR_OR, 0, 0, 0, 0, 0, 0,
-     ~RL_EXPR_OR, 31, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 32, 36, 41, 50, 57, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {~RL_XOR, 0, 0, 0, 0, ~RL_XOR, ~RL_XOR, 0, 0, 0, 0, 0, 34, ~RL_XOR, ~RL_XOR,
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_EXPR_XOR, 0, 0, 0, 0, ~RL_EXPR_XOR, ~RL_EXPR_XOR, 0, 0, 0, 0, 0, 34,
-     ~RL_EXPR_XOR, ~RL_EXPR_XOR, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 35, 41, 50, 57, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {~RL_AND, 0, 0, 0, 0, ~RL_AND, ~RL_AND, 0, 0, 0, 0, 0, ~RL_AND, ~RL_AND,
-     ~RL_AND, 0, 37, 38, 0, 0, 0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_EXPR_AND, 0, 0, 0, 0, ~RL_EXPR_AND, ~RL_EXPR_AND, 0, 0, 0, 0, 0,
-     ~RL_EXPR_AND, ~RL_EXPR_AND, ~RL_EXPR_AND, 0, 37, 38, 0, 0, 0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 39, 50, 57, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 40, 50, 57, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {~RL_EQ, 0, 0, 0, 0, ~RL_EQ, ~RL_EQ, 0, 0, 0, 0, 0, ~RL_EQ, ~RL_EQ, ~RL_EQ,
-     0, ~RL_EQ, ~RL_EQ, 42, 43, 44, 45, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_NEQ, 0, 0, 0, 0, ~RL_NEQ, ~RL_NEQ, 0, 0, 0, 0, 0, ~RL_NEQ, ~RL_NEQ,
-     ~RL_NEQ, 0, ~RL_NEQ, ~RL_NEQ, 42, 43, 44, 45, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_EXPR_EQ, 0, 0, 0, 0, ~RL_EXPR_EQ, ~RL_EXPR_EQ, 0, 0, 0, 0, 0,
-     ~RL_EXPR_EQ, ~RL_EXPR_EQ, ~RL_EXPR_EQ, 0, ~RL_EXPR_EQ, ~RL_EXPR_EQ, 42, 43,
-     44, 45, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 46, 57, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 47, 57, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 57, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 57, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {~RL_LT, 0, 0, 0, 0, ~RL_LT, ~RL_LT, 0, 0, 0, 0, 0, ~RL_LT, ~RL_LT, ~RL_LT,
-     0, ~RL_LT, ~RL_LT, ~RL_LT, ~RL_LT, ~RL_LT, ~RL_LT, 51, 52, 53,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_LEQ, 0, 0, 0, 0, ~RL_LEQ, ~RL_LEQ, 0, 0, 0, 0, 0, ~RL_LEQ, ~RL_LEQ,
-     ~RL_LEQ, 0, ~RL_LEQ, ~RL_LEQ, ~RL_LEQ, ~RL_LEQ, ~RL_LEQ, ~RL_LEQ, 51, 52,
-     53,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_GT, 0, 0, 0, 0, ~RL_GT, ~RL_GT, 0, 0, 0, 0, 0, ~RL_GT, ~RL_GT, ~RL_GT,
-     0, ~RL_GT, ~RL_GT, ~RL_GT, ~RL_GT, ~RL_GT, ~RL_GT, 51, 52, 53,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_GEQ, 0, 0, 0, 0, ~RL_GEQ, ~RL_GEQ, 0, 0, 0, 0, 0, ~RL_GEQ, ~RL_GEQ,
-     ~RL_GEQ, 0, ~RL_GEQ, ~RL_GEQ, ~RL_GEQ, ~RL_GEQ, ~RL_GEQ, ~RL_GEQ, 51, 52,
-     53,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_EXPR_CMP, 0, 0, 0, 0, ~RL_EXPR_CMP, ~RL_EXPR_CMP, 0, 0, 0, 0, 0,
-     ~RL_EXPR_CMP, ~RL_EXPR_CMP, ~RL_EXPR_CMP, 0, ~RL_EXPR_CMP, ~RL_EXPR_CMP,
-     ~RL_EXPR_CMP, ~RL_EXPR_CMP, ~RL_EXPR_CMP, ~RL_EXPR_CMP, 51, 52, 53,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 54, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 55, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 56, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {~RL_LL, 0, 0, 0, 0, ~RL_LL, ~RL_LL, 58, 59, 0, 0, 0, ~RL_LL, ~RL_LL,
-     ~RL_LL, 0, ~RL_LL, ~RL_LL, ~RL_LL, ~RL_LL, ~RL_LL, ~RL_LL, ~RL_LL, ~RL_LL,
-     ~RL_LL,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_GG, 0, 0, 0, 0, ~RL_GG, ~RL_GG, 58, 59, 0, 0, 0, ~RL_GG, ~RL_GG,
-     ~RL_GG, 0, ~RL_GG, ~RL_GG, ~RL_GG, ~RL_GG, ~RL_GG, ~RL_GG, ~RL_GG, ~RL_GG,
-     ~RL_GG,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_GGG, 0, 0, 0, 0, ~RL_GGG, ~RL_GGG, 58, 59, 0, 0, 0, ~RL_GGG, ~RL_GGG,
-     ~RL_GGG, 0, ~RL_GGG, ~RL_GGG, ~RL_GGG, ~RL_GGG, ~RL_GGG, ~RL_GGG, ~RL_GGG,
-     ~RL_GGG, ~RL_GGG,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_EXPR_SHIFT, 0, 0, 0, 0, ~RL_EXPR_SHIFT, ~RL_EXPR_SHIFT, 58, 59, 0, 0,
-     0, ~RL_EXPR_SHIFT, ~RL_EXPR_SHIFT, ~RL_EXPR_SHIFT, 0, ~RL_EXPR_SHIFT,
-     ~RL_EXPR_SHIFT, ~RL_EXPR_SHIFT, ~RL_EXPR_SHIFT, ~RL_EXPR_SHIFT,
-     ~RL_EXPR_SHIFT, ~RL_EXPR_SHIFT, ~RL_EXPR_SHIFT, ~RL_EXPR_SHIFT,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 60, 69, 70, 18, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 61, 69, 70, 18, 0, 0, 0, 0},
-
-    {~RL_ADD, 0, 0, 0, 0, ~RL_ADD, ~RL_ADD, ~RL_ADD, ~RL_ADD, 63, 64, 65,
-     ~RL_ADD, ~RL_ADD, ~RL_ADD, 0, ~RL_ADD, ~RL_ADD, ~RL_ADD, ~RL_ADD, ~RL_ADD,
-     ~RL_ADD, ~RL_ADD, ~RL_ADD, ~RL_ADD,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_SUB, 0, 0, 0, 0, ~RL_SUB, ~RL_SUB, ~RL_SUB, ~RL_SUB, 63, 64, 65,
-     ~RL_SUB, ~RL_SUB, ~RL_SUB, 0, ~RL_SUB, ~RL_SUB, ~RL_SUB, ~RL_SUB, ~RL_SUB,
-     ~RL_SUB, ~RL_SUB, ~RL_SUB, ~RL_SUB,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_EXPR_ADDSUB, 0, 0, 0, 0, ~RL_EXPR_ADDSUB, ~RL_EXPR_ADDSUB,
-     ~RL_EXPR_ADDSUB, ~RL_EXPR_ADDSUB, 63, 64, 65, ~RL_EXPR_ADDSUB,
-     ~RL_EXPR_ADDSUB, ~RL_EXPR_ADDSUB, 0, ~RL_EXPR_ADDSUB, ~RL_EXPR_ADDSUB,
-     ~RL_EXPR_ADDSUB, ~RL_EXPR_ADDSUB, ~RL_EXPR_ADDSUB, ~RL_EXPR_ADDSUB,
-     ~RL_EXPR_ADDSUB, ~RL_EXPR_ADDSUB, ~RL_EXPR_ADDSUB,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 66, 70, 18, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 67, 70, 18, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 68, 70, 18, 0, 0, 0, 0},
-
-    {~RL_MUL, 0, 0, 0, 0, ~RL_MUL, ~RL_MUL, ~RL_MUL, ~RL_MUL, ~RL_MUL, ~RL_MUL,
-     ~RL_MUL, ~RL_MUL, ~RL_MUL, ~RL_MUL, 0, ~RL_MUL, ~RL_MUL, ~RL_MUL, ~RL_MUL,
-     ~RL_MUL, ~RL_MUL, ~RL_MUL, ~RL_MUL, ~RL_MUL,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_DIV, 0, 0, 0, 0, ~RL_DIV, ~RL_DIV, ~RL_DIV, ~RL_DIV, ~RL_DIV, ~RL_DIV,
-     ~RL_DIV, ~RL_DIV, ~RL_DIV, ~RL_DIV, 0, ~RL_DIV, ~RL_DIV, ~RL_DIV, ~RL_DIV,
-     ~RL_DIV, ~RL_DIV, ~RL_DIV, ~RL_DIV, ~RL_DIV,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_MOD, 0, 0, 0, 0, ~RL_MOD, ~RL_MOD, ~RL_MOD, ~RL_MOD, ~RL_MOD, ~RL_MOD,
-     ~RL_MOD, ~RL_MOD, ~RL_MOD, ~RL_MOD, 0, ~RL_MOD, ~RL_MOD, ~RL_MOD, ~RL_MOD,
-     ~RL_MOD, ~RL_MOD, ~RL_MOD, ~RL_MOD, ~RL_MOD,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_EXPR_MULDIV, 0, 0, 0, 0, ~RL_EXPR_MULDIV, ~RL_EXPR_MULDIV,
-     ~RL_EXPR_MULDIV, ~RL_EXPR_MULDIV, ~RL_EXPR_MULDIV, ~RL_EXPR_MULDIV,
-     ~RL_EXPR_MULDIV, ~RL_EXPR_MULDIV, ~RL_EXPR_MULDIV, ~RL_EXPR_MULDIV, 0,
-     ~RL_EXPR_MULDIV, ~RL_EXPR_MULDIV, ~RL_EXPR_MULDIV, ~RL_EXPR_MULDIV,
-     ~RL_EXPR_MULDIV, ~RL_EXPR_MULDIV, ~RL_EXPR_MULDIV, ~RL_EXPR_MULDIV,
-     ~RL_EXPR_MULDIV,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_EXPR_UNARY, 0, 0, 0, 0, ~RL_EXPR_UNARY, ~RL_EXPR_UNARY, ~RL_EXPR_UNARY,
-     ~RL_EXPR_UNARY, ~RL_EXPR_UNARY, ~RL_EXPR_UNARY, ~RL_EXPR_UNARY,
-     ~RL_EXPR_UNARY, ~RL_EXPR_UNARY, ~RL_EXPR_UNARY, 0, ~RL_EXPR_UNARY,
-     ~RL_EXPR_UNARY, ~RL_EXPR_UNARY, ~RL_EXPR_UNARY, ~RL_EXPR_UNARY,
-     ~RL_EXPR_UNARY, ~RL_EXPR_UNARY, ~RL_EXPR_UNARY, ~RL_EXPR_UNARY,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 72, 70, 18, 0, 0, 0, 0},
-
-    {~RL_NOT, 0, 0, 0, 0, ~RL_NOT, ~RL_NOT, ~RL_NOT, ~RL_NOT, ~RL_NOT, ~RL_NOT,
-     ~RL_NOT, ~RL_NOT, ~RL_NOT, ~RL_NOT, 0, ~RL_NOT, ~RL_NOT, ~RL_NOT, ~RL_NOT,
-     ~RL_NOT, ~RL_NOT, ~RL_NOT, ~RL_NOT, ~RL_NOT,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 74, 70, 18, 0, 0, 0, 0},
-
-    {~RL_UPLUS, 0, 0, 0, 0, ~RL_UPLUS, ~RL_UPLUS, ~RL_UPLUS, ~RL_UPLUS,
-     ~RL_UPLUS, ~RL_UPLUS, ~RL_UPLUS, ~RL_UPLUS, ~RL_UPLUS, ~RL_UPLUS, 0,
-     ~RL_UPLUS, ~RL_UPLUS, ~RL_UPLUS, ~RL_UPLUS, ~RL_UPLUS, ~RL_UPLUS,
-     ~RL_UPLUS, ~RL_UPLUS, ~RL_UPLUS,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 76, 70, 18, 0, 0, 0, 0},
-
-    {~RL_UMINUS, 0, 0, 0, 0, ~RL_UMINUS, ~RL_UMINUS, ~RL_UMINUS, ~RL_UMINUS,
-     ~RL_UMINUS, ~RL_UMINUS, ~RL_UMINUS, ~RL_UMINUS, ~RL_UMINUS, ~RL_UMINUS, 0,
-     ~RL_UMINUS, ~RL_UMINUS, ~RL_UMINUS, ~RL_UMINUS, ~RL_UMINUS, ~RL_UMINUS,
-     ~RL_UMINUS, ~RL_UMINUS, ~RL_UMINUS,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {0, 17, 19, 0, 77, 0, 0, 73, 75, 0, 0, 0, 0, 0, 0, 71, 0, 0, 0, 0, 0, 0, 0,
-     0, 0,
-     //
-     0, 0, 0, 0, 78, 30, 33, 36, 41, 50, 57, 62, 69, 70, 18, 0, 0, 0, 0},
-
-    {0, 0, 0, 0, 0, 79, 0, 0, 0, 0, 0, 0, 0, 28, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_TERM_GROUP, 0, 0, 0, 0, ~RL_TERM_GROUP, ~RL_TERM_GROUP, ~RL_TERM_GROUP,
-     ~RL_TERM_GROUP, ~RL_TERM_GROUP, ~RL_TERM_GROUP, ~RL_TERM_GROUP,
-     ~RL_TERM_GROUP, ~RL_TERM_GROUP, ~RL_TERM_GROUP, 0, ~RL_TERM_GROUP,
-     ~RL_TERM_GROUP, ~RL_TERM_GROUP, ~RL_TERM_GROUP, ~RL_TERM_GROUP,
-     ~RL_TERM_GROUP, ~RL_TERM_GROUP, ~RL_TERM_GROUP, ~RL_TERM_GROUP,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-    {~RL_STMT_SETVAR, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-     0, 0, 0, 0, 0,
-     //
-     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-
-};
-
 typedef struct {
     enum nonterminal nt;
-    char ntokens;
-    char arg1pos;
-    char arg2pos;
-    char arg3pos;
+    signed char ntokens;
+    signed char arg1pos;
+    signed char arg2pos;
+    signed char arg3pos;
 } ruledef_entry_t;
 
-static const ruledef_entry_t rules[NRULES] = {
-    {NT_STMT, 1, 0, -1, -1},         {NT_STMT, 1, 0, -1, -1},
-    {NT_SETVAR, 1, 0, -1, -1},       {NT_SETVAR, 1, 0, -1, -1},
-    {NT_ASSIGN, 3, 0, 2, -1},        {NT_FUNDEF, 6, 0, 2, 5},
-    {NT_EXPR_OR, 1, 0, -1, -1},      {NT_EXPR_OR, 3, 0, 2, -1},
-    {NT_EXPR_XOR, 1, 0, -1, -1},     {NT_EXPR_XOR, 3, 0, 2, -1},
-    {NT_EXPR_AND, 1, 0, -1, -1},     {NT_EXPR_AND, 3, 0, 2, -1},
-    {NT_EXPR_EQ, 1, 0, -1, -1},      {NT_EXPR_EQ, 3, 0, 2, -1},
-    {NT_EXPR_EQ, 3, 0, 2, -1},       {NT_EXPR_CMP, 1, 0, -1, -1},
-    {NT_EXPR_CMP, 3, 0, 2, -1},      {NT_EXPR_CMP, 3, 0, 2, -1},
-    {NT_EXPR_CMP, 3, 0, 2, -1},      {NT_EXPR_CMP, 3, 0, 2, -1},
-    {NT_EXPR_SHIFT, 1, 0, -1, -1},   {NT_EXPR_SHIFT, 3, 0, 2, -1},
-    {NT_EXPR_SHIFT, 3, 0, 2, -1},    {NT_EXPR_SHIFT, 3, 0, 2, -1},
-    {NT_EXPR_ADDSUB, 1, 0, -1, -1},  {NT_EXPR_ADDSUB, 3, 0, 2, -1},
-    {NT_EXPR_ADDSUB, 3, 0, 2, -1},   {NT_EXPR_MULDIV, 1, 0, -1, -1},
-    {NT_EXPR_MULDIV, 3, 0, 2, -1},   {NT_EXPR_MULDIV, 3, 0, 2, -1},
-    {NT_EXPR_MULDIV, 3, 0, 2, -1},   {NT_EXPR_UNARY, 1, 0, -1, -1},
-    {NT_EXPR_UNARY, 2, 1, -1, -1},   {NT_EXPR_UNARY, 2, 1, -1, -1},
-    {NT_EXPR_UNARY, 2, 1, -1, -1},   {NT_TERM, 1, 0, -1, -1},
-    {NT_TERM, 1, 0, -1, -1},         {NT_TERM, 1, 0, -1, -1},
-    {NT_TERM, 3, 1, -1, -1},         {NT_FUNCALL, 4, 0, 2, 3},
-    {NT_IDLIST_OPT, 0, -1, -1, -1},  {NT_IDLIST_OPT, 1, 0, -1, -1},
-    {NT_IDLIST, 1, 0, -1, -1},       {NT_IDLIST, 3, 0, 2, -1},
-    {NT_ARGLIST_OPT, 0, -1, -1, -1}, {NT_ARGLIST_OPT, 1, 0, -1, -1},
-    {NT_ARGLIST, 1, 0, -1, -1},      {NT_ARGLIST, 3, 0, 2, -1}};
-
-static signed char state_stack[256];
-static symb_t ast_stack[256];
+typedef struct {
+    signed char prec;  // 0: not an operator
+    signed char right;
+    signed char type;
+} prec_op_t;
+
+// rules[], the operator tables and the action/goto tables are generated by
+// slrgen from mincalc.grammar.  The action/goto tables are stored in
+// comb-vector form: rows with identical explicit actions are shared, each
+// state falls back to a default reduction, and the remaining entries of all
+// rows are packed into one vector guarded by a check array.
+#include "parser_tables.h"
+
+static signed char slr_action(int state, int tok) {
+    int row = slr_action_row[state];
+    int i = slr_action_base[row] + tok;
+    if (slr_action_check[i] == row) {
+        return slr_action_value[i];
+    }
+    return slr_action_default[state];
+}
+
+static signed char slr_goto(int state, int nt) {
+    nt -= NTOKTYPE;
+    int i = slr_goto_base[nt] + state;
+    if (slr_goto_check[i] == nt) {
+        return slr_goto_value[i];
+    }
+    return slr_goto_default[nt];
+}
+
+unsigned long parser_max_depth = PARSER_MAX_DEPTH;
+
+// The stacks start out in static storage, which ordinary lines never
+// outgrow.  On the host deeper nesting doubles them on the heap, and the
+// grown stacks are kept for the lines that follow.
+#define SLR_STACK_SIZE 256
+static signed char state_init[SLR_STACK_SIZE];
+static symb_t ast_init[SLR_STACK_SIZE];
+static signed char *state_stack = state_init;
+static symb_t *ast_stack = ast_init;
+static int stack_size = SLR_STACK_SIZE;
 static int stack_len;
 
 void init_slr_svar() {
     stack_len = 1;
-    state_stack[0] = 1;
+    state_stack[0] = SLR_STATE_SVAR;
 }
 
 void init_slr_expr() {
     stack_len = 1;
-    state_stack[0] = 16;
+    state_stack[0] = SLR_STATE_EXPR;
 }
 
 #define PARSER_MEM_SIZE 1024
 static symb_t mem[PARSER_MEM_SIZE];
 static symb_t *mem_p = mem;
 
-void clear_slr_mem() { mem_p = mem; }
+// nodes are only freed here, so the pool is at its peak before each release
+void clear_slr_mem() {
+    STAT_POOL(STAT_POOL_PARSER_NODES, mem_p - mem, PARSER_MEM_SIZE);
+    mem_p = mem;
+}
+
+symb_t *get_slr_mem_mark() { return mem_p; }
+
+size_t slr_mem_free() { return (size_t)(mem + PARSER_MEM_SIZE - mem_p); }
+
+void release_slr_mem(symb_t *mark) {
+    STAT_POOL(STAT_POOL_PARSER_NODES, mem_p - mem, PARSER_MEM_SIZE);
+    mem_p = mark;
+}
 
 #define SLR_DIE(msg)                 \
     do {                             \
-        mc_puts("PARSER ERR: " msg); \
+        mc_error("PARSER", msg);     \
+        STAT_ERROR(STAT_ERR_PARSER); \
         return 1;                    \
     } while (0)
 
+// Calls of built-in functions have their arguments checked as soon as they
+// are parsed: their number, and that those naming bound variables are
+// identifiers.
+static int check_call(const symb_t *call) {
+    const builtin_t *b = builtin_lookup(call->arg1->token.idname);
+    if (b == NULL) {
+        return 0;
+    }
+    int n = 0;
+    int bad_name = 0;
+    if (call->arg2->type == ~RL_ARGLIST_OPT_1) {
+        const symb_t *arg = call->arg2->arg1;
+        while (1) {
+            const symb_t *expr = arg->arg1;
+            if ((b->bound >> n & 1) != 0 && expr->type != TOK_ID &&
+                expr->type != ~RL_TERM_ID) {
+                bad_name = 1;
+            }
+            n++;
+            if (arg->type != ~RL_ARGLIST_CONS) {
+                break;
+            }
+            arg = arg->arg2;
+        }
+    }
+    if (n != b->nargs) SLR_DIE("wrong number of arguments");
+    if (bad_name) SLR_DIE("expected a variable name");
+    return 0;
+}
+
+#ifndef __FPGA_EXP__
+
+#include <stdlib.h>
+#include <string.h>
+
+static int grow_stacks(void) {
+    int size = stack_size * 2;
+    if (size > PARSER_MAX_DEPTH) {
+        size = PARSER_MAX_DEPTH;
+    }
+    signed char *states = realloc(
+        state_stack == state_init ? NULL : state_stack, (size_t)size);
+    if (states == NULL) SLR_DIE("ran out of memory");
+    if (state_stack == state_init) {
+        memcpy(states, state_init, sizeof(state_init));
+    }
+    state_stack = states;
+    symb_t *asts = realloc(ast_stack == ast_init ? NULL : ast_stack,
+                           (size_t)size * sizeof(symb_t));
+    if (asts == NULL) SLR_DIE("ran out of memory");
+    if (ast_stack == ast_init) {
+        memcpy(asts, ast_init, sizeof(ast_init));
+    }
+    ast_stack = asts;
+    stack_size = size;
+    return 0;
+}
+
+#endif
+
+// Makes room for one more entry on the stacks.
+static int slr_reserve(void) {
+    if ((unsigned long)stack_len >= parser_max_depth) {
+        SLR_DIE("nesting too deep");
+    }
+    if (stack_len < stack_size) {
+        return 0;
+    }
+#ifdef __FPGA_EXP__
+    SLR_DIE("nesting too deep");
+#else
+    return grow_stacks();
+#endif
+}
+
 int slr_feed_token(token_t *tok) {
-    signed char next = slr_table[state_stack[stack_len - 1]][tok->type];
-    if (next == 0) SLR_DIE("unexpected token");
+    signed char next = slr_action(state_stack[stack_len - 1], tok->type);
     while (next < 0) {
         // reduce
         ruledef_entry_t rule = rules[~next];
@@ -560,6 +225,9 @@ int slr_feed_token(token_t *tok) {
         if (stack_len - 1 < ntokens) {
             SLR_DIE("internal error");
         }
+        if (ntokens == 0 && slr_reserve() != 0) {
+            return 1;
+        }
         if (mem_p - mem + 3 > PARSER_MEM_SIZE) {
             SLR_DIE("ran out of memory");
         }
@@ -580,16 +248,28 @@ int slr_feed_token(token_t *tok) {
             newsymb.arg3 = mem_p;
             *(mem_p++) = ast_stack[stack_len - ntokens + arg3pos];
         }
+        if (next == ~RL_FUNCALL && check_call(&newsymb) != 0) {
+            return 1;
+        }
         stack_len -= ntokens;
         ast_stack[stack_len] = newsymb;
-        state_stack[stack_len] = slr_table[state_stack[stack_len - 1]][rule.nt];
+        state_stack[stack_len] = slr_goto(state_stack[stack_len - 1], rule.nt);
         stack_len++;
-        next = slr_table[state_stack[stack_len - 1]][tok->type];
+        next = slr_action(state_stack[stack_len - 1], tok->type);
+    }
+    // default reductions may run before an erroneous token is noticed; the
+    // accepting state 0 is the only one that takes a zero action
+    if (next == 0 && state_stack[stack_len - 1] != 0) {
+        SLR_DIE("unexpected token");
     }
     // shift
+    if (slr_reserve() != 0) {
+        return 1;
+    }
     ast_stack[stack_len].token = *tok;
     state_stack[stack_len] = next;
     stack_len++;
+    STAT_POOL(STAT_POOL_PARSER_STACK, stack_len, stack_size);
     return 0;
 }
 
@@ -600,11 +280,155 @@ symb_t *slr_get_result() {
     if (ast_stack[2].token.type != TOK_EOS) {
         return NULL;
     }
-    if (state_stack[0] == 1 && ast_stack[1].type == ~RL_STMT_SETVAR) {
+    if (state_stack[0] == SLR_STATE_SVAR &&
+        ast_stack[1].type == ~RL_STMT_SETVAR) {
         return &ast_stack[1];
     }
-    if (state_stack[0] == 16 && ast_stack[1].type == ~RL_STMT_EXPR) {
+    if (state_stack[0] == SLR_STATE_EXPR &&
+        ast_stack[1].type == ~RL_STMT_EXPR) {
         return &ast_stack[1];
     }
     return NULL;
 }
+
+// Returns the number of children (arg1 ... arg3) of nodes built by rule.
+int slr_rule_nargs(int rule) {
+    const ruledef_entry_t *r = &rules[rule];
+    return (r->arg1pos >= 0) + (r->arg2pos >= 0) + (r->arg3pos >= 0);
+}
+
+// ===========================
+// precedence climbing parser
+// ===========================
+
+// Parses expressions straight into evaluable trees: operands are bare token
+// nodes, groups are not wrapped, and no unit-chain reductions are performed.
+// Node types and the shape of function calls are the same as in the trees
+// built by slr_feed_token.
+
+static token_t prec_tok;
+static const char **prec_str;
+static int prec_depth;
+
+static int prec_next(void) { return get_next_tok(&prec_tok, prec_str); }
+
+static symb_t *prec_new_node(int type) {
+    if (mem_p - mem >= PARSER_MEM_SIZE) {
+        mc_error("PARSER", "ran out of memory");
+        STAT_ERROR(STAT_ERR_PARSER);
+        return NULL;
+    }
+    mem_p->type = type;
+    return mem_p++;
+}
+
+static symb_t *prec_new_token(void) {
+    symb_t *node = prec_new_node(prec_tok.type);
+    if (node != NULL) {
+        node->token = prec_tok;
+    }
+    return node;
+}
+
+static int prec_expr(symb_t **result, int min_prec);
+
+static int prec_arglist(symb_t **result) {
+    symb_t *expr;
+    if (prec_expr(&expr, 1) != 0) {
+        return 1;
+    }
+    if (prec_tok.type != TOK_COMMA) {
+        if ((*result = prec_new_node(~RL_ARGLIST)) == NULL) return 1;
+        (*result)->arg1 = expr;
+        return 0;
+    }
+    if ((*result = prec_new_node(~RL_ARGLIST_CONS)) == NULL) return 1;
+    (*result)->arg1 = expr;
+    if (prec_next() != 0) return 1;
+    return prec_arglist(&(*result)->arg2);
+}
+
+static int prec_operand(symb_t **result) {
+    const prec_op_t *op = &prec_prefix[prec_tok.type];
+    switch (prec_tok.type) {
+        case TOK_NUM:
+            if ((*result = prec_new_token()) == NULL) return 1;
+            return prec_next();
+        case TOK_ID: {
+            symb_t *id = prec_new_token();
+            if (id == NULL || prec_next() != 0) return 1;
+            if (prec_tok.type != TOK_LPAR) {
+                *result = id;
+                return 0;
+            }
+            symb_t *call = prec_new_node(~RL_FUNCALL);
+            if (call == NULL || prec_next() != 0) return 1;
+            call->arg1 = id;
+            if (prec_tok.type == TOK_RPAR) {
+                call->arg2 = prec_new_node(~RL_ARGLIST_OPT_0);
+                if (call->arg2 == NULL) return 1;
+            } else {
+                call->arg2 = prec_new_node(~RL_ARGLIST_OPT_1);
+                if (call->arg2 == NULL) return 1;
+                if (prec_arglist(&call->arg2->arg1) != 0) return 1;
+                if (prec_tok.type != TOK_RPAR) SLR_DIE("unexpected token");
+            }
+            if ((call->arg3 = prec_new_token()) == NULL) return 1;
+            *result = call;
+            // checked after the next token, like the SLR parser does
+            if (prec_next() != 0) return 1;
+            return check_call(call);
+        }
+        case TOK_LPAR:
+            if (prec_next() != 0 || prec_expr(result, 1) != 0) return 1;
+            if (prec_tok.type != TOK_RPAR) SLR_DIE("unexpected token");
+            return prec_next();
+        default:
+            break;
+    }
+    if (op->prec == 0) SLR_DIE("unexpected token");
+    if ((*result = prec_new_node(op->type)) == NULL) return 1;
+    if (prec_next() != 0) return 1;
+    return prec_expr(&(*result)->arg1, op->prec);
+}
+
+static int prec_expr(symb_t **result, int min_prec) {
+    if ((unsigned long)++prec_depth > parser_max_depth) {
+        SLR_DIE("nesting too deep");
+    }
+    if (prec_operand(result) != 0) {
+        return 1;
+    }
+    while (1) {
+        const prec_op_t *op = &prec_infix[prec_tok.type];
+        if (op->prec == 0 || op->prec < min_prec) {
+            break;
+        }
+        symb_t *node = prec_new_node(op->type);
+        if (node == NULL || prec_next() != 0) return 1;
+        node->arg1 = *result;
+        if (prec_expr(&node->arg2, op->prec + !op->right) != 0) {
+            return 1;
+        }
+        *result = node;
+    }
+    prec_depth--;
+    return 0;
+}
+
+int prec_parse_expr(symb_t **result, const char **str) {
+    prec_str = str;
+    prec_depth = 0;
+    if (prec_next() != 0) {
+        return 1;
+    }
+    if (prec_tok.type == TOK_EOS) {
+        *result = NULL;
+        return 0;
+    }
+    if (prec_expr(result, 1) != 0) {
+        return 1;
+    }
+    if (prec_tok.type != TOK_EOS) SLR_DIE("unexpected token");
+    return 0;
+}
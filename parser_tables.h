@@ -0,0 +1,215 @@
+/*
+ * parser_tables.h
+ *
+ * Generated by slrgen from mincalc.grammar. Do not edit.
+ */
+
+typedef char slr_check_tokens[(NTOKTYPE == 26 &&
+                               TOK_EOS == 0 &&
+                               TOK_NUM == 1 &&
+                               TOK_ID == 2 &&
+                               TOK_DEFEQ == 3 &&
+                               TOK_BINDEQ == 4 &&
+                               TOK_LPAR == 5 &&
+                               TOK_RPAR == 6 &&
+                               TOK_COMMA == 7 &&
+                               TOK_PLUS == 8 &&
+                               TOK_MINUS == 9 &&
+                               TOK_MUL == 10 &&
+                               TOK_DIV == 11 &&
+                               TOK_MOD == 12 &&
+                               TOK_AND == 13 &&
+                               TOK_OR == 14 &&
+                               TOK_XOR == 15 &&
+                               TOK_NOT == 16 &&
+                               TOK_EQ == 17 &&
+                               TOK_NEQ == 18 &&
+                               TOK_LT == 19 &&
+                               TOK_LEQ == 20 &&
+                               TOK_GT == 21 &&
+                               TOK_GEQ == 22 &&
+                               TOK_LL == 23 &&
+                               TOK_GG == 24 &&
+                               TOK_GGG == 25) ? 1 : -1];
+
+static const ruledef_entry_t rules[NRULES] = {
+    {NT_STMT, 1, 0, -1, -1}, // RL_STMT_SETVAR
+    {NT_STMT, 1, 0, -1, -1}, // RL_STMT_EXPR
+    {NT_SETVAR, 1, 0, -1, -1}, // RL_SETVAR_ASSIGN
+    {NT_SETVAR, 1, 0, -1, -1}, // RL_SETVAR_FUNDEF
+    {NT_SETVAR, 1, 0, -1, -1}, // RL_SETVAR_BIND
+    {NT_ASSIGN, 3, 0, 2, -1}, // RL_ASSIGN
+    {NT_FUNDEF, 6, 0, 2, 5}, // RL_FUNDEF
+    {NT_BIND, 3, 0, 2, -1}, // RL_BIND
+    {NT_EXPR, 3, 0, 2, -1}, // RL_OR
+    {NT_EXPR, 3, 0, 2, -1}, // RL_XOR
+    {NT_EXPR, 3, 0, 2, -1}, // RL_AND
+    {NT_EXPR, 3, 0, 2, -1}, // RL_EQ
+    {NT_EXPR, 3, 0, 2, -1}, // RL_NEQ
+    {NT_EXPR, 3, 0, 2, -1}, // RL_LT
+    {NT_EXPR, 3, 0, 2, -1}, // RL_LEQ
+    {NT_EXPR, 3, 0, 2, -1}, // RL_GT
+    {NT_EXPR, 3, 0, 2, -1}, // RL_GEQ
+    {NT_EXPR, 3, 0, 2, -1}, // RL_LL
+    {NT_EXPR, 3, 0, 2, -1}, // RL_GG
+    {NT_EXPR, 3, 0, 2, -1}, // RL_GGG
+    {NT_EXPR, 3, 0, 2, -1}, // RL_ADD
+    {NT_EXPR, 3, 0, 2, -1}, // RL_SUB
+    {NT_EXPR, 3, 0, 2, -1}, // RL_MUL
+    {NT_EXPR, 3, 0, 2, -1}, // RL_DIV
+    {NT_EXPR, 3, 0, 2, -1}, // RL_MOD
+    {NT_EXPR, 2, 1, -1, -1}, // RL_NOT
+    {NT_EXPR, 2, 1, -1, -1}, // RL_UPLUS
+    {NT_EXPR, 2, 1, -1, -1}, // RL_UMINUS
+    {NT_EXPR, 1, 0, -1, -1}, // RL_TERM_INT
+    {NT_EXPR, 1, 0, -1, -1}, // RL_TERM_ID
+    {NT_EXPR, 3, 1, -1, -1}, // RL_TERM_GROUP
+    {NT_EXPR, 4, 0, 2, 3}, // RL_FUNCALL
+    {NT_IDLIST_OPT, 0, -1, -1, -1}, // RL_IDLIST_OPT_0
+    {NT_IDLIST_OPT, 1, 0, -1, -1}, // RL_IDLIST_OPT_1
+    {NT_IDLIST, 1, 0, -1, -1}, // RL_IDLIST
+    {NT_IDLIST, 3, 0, 2, -1}, // RL_IDLIST_CONS
+    {NT_ARGLIST_OPT, 0, -1, -1, -1}, // RL_ARGLIST_OPT_0
+    {NT_ARGLIST_OPT, 1, 0, -1, -1}, // RL_ARGLIST_OPT_1
+    {NT_ARGLIST, 1, 0, -1, -1}, // RL_ARGLIST
+    {NT_ARGLIST, 3, 0, 2, -1}, // RL_ARGLIST_CONS
+};
+
+static const prec_op_t prec_infix[NTOKTYPE] = {
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {7, 0, ~RL_ADD}, // TOK_PLUS
+    {7, 0, ~RL_SUB}, // TOK_MINUS
+    {8, 0, ~RL_MUL}, // TOK_MUL
+    {8, 0, ~RL_DIV}, // TOK_DIV
+    {8, 0, ~RL_MOD}, // TOK_MOD
+    {3, 0, ~RL_AND}, // TOK_AND
+    {1, 0, ~RL_OR}, // TOK_OR
+    {2, 0, ~RL_XOR}, // TOK_XOR
+    {0, 0, 0},
+    {4, 0, ~RL_EQ}, // TOK_EQ
+    {4, 0, ~RL_NEQ}, // TOK_NEQ
+    {5, 0, ~RL_LT}, // TOK_LT
+    {5, 0, ~RL_LEQ}, // TOK_LEQ
+    {5, 0, ~RL_GT}, // TOK_GT
+    {5, 0, ~RL_GEQ}, // TOK_GEQ
+    {6, 0, ~RL_LL}, // TOK_LL
+    {6, 0, ~RL_GG}, // TOK_GG
+    {6, 0, ~RL_GGG}, // TOK_GGG
+};
+
+static const prec_op_t prec_prefix[NTOKTYPE] = {
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {9, 1, ~RL_UPLUS}, // TOK_PLUS
+    {9, 1, ~RL_UMINUS}, // TOK_MINUS
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {9, 1, ~RL_NOT}, // TOK_NOT
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+    {0, 0, 0},
+};
+
+#define SLR_NSTATES 74
+#define SLR_STATE_SVAR 1
+#define SLR_STATE_EXPR 2
+
+static const signed char slr_action_row[74] = {
+    0, 1, 2, 3, 4, 0, 0, 0, 0, 5, 2, 2, 2, 2, 6, 2,
+    2, 7, 2, 8, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 2, 2, 2, 2, 9, 9, 10, 11, 0, 12, 13, 0,
+    0, 14, 14, 0, 0, 0, 15, 16, 17, 18, 18, 19, 19, 19, 19, 20,
+    20, 20, 7, 21, 2, 0, 0, 2, 0, 9,
+};
+
+static const signed char slr_action_default[74] = {
+    0, 0, 0, 0, 0, -3, -4, -5, -29, -30, 0, 0, 0, 0, 0, 0,
+    0, -33, -37, 0, -27, -28, -26, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, -6, -8, -35, 0, -34, -39, 0, -38,
+    -31, -21, -22, -23, -24, -25, -11, -9, -10, -12, -13, -14, -15, -16, -17, -18,
+    -19, -20, 0, 0, 0, -32, -36, 0, -40, -7,
+};
+
+static const unsigned char slr_action_base[22] = {
+    0, 0, 159, 0, 1, 1, 0, 5, 20, 57, 9, 21, 39, 30, 97, 111,
+    75, 93, 129, 134, 161, 52,
+};
+
+static const signed char slr_action_check[187] = {
+    6, 4, 1, 3, 3, 3, 5, 7, 6, 6, 6, 6, 6, 6, 6, 6,
+    10, 6, 6, 6, 6, 6, 6, 6, 6, 6, 8, 11, 8, 8, 8, 8,
+    8, 8, 8, 8, 13, 8, 8, 8, 8, 8, 8, 8, 8, 8, 12, 12,
+    12, 12, 12, 12, 12, 12, 12, 21, 12, 12, 12, 12, 12, 12, 12, 12,
+    12, 9, 9, 9, 9, 9, 9, 9, 9, -1, 9, 9, 9, 9, 9, 9,
+    9, 9, 9, 16, 16, 16, 16, 16, 16, -1, 16, -1, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 17, 17, 17, 17, 17, 17, 14, 14, 14, 17, 17,
+    17, 17, 17, 17, 17, 17, 17, 15, 15, 15, 15, 15, -1, -1, -1, -1,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 18, 18, 18, 18, 18, 19, 19,
+    19, 19, 19, -1, 18, 18, 18, 18, 18, 18, 18, -1, -1, 19, 19, 19,
+    2, 2, -1, -1, 2, -1, -1, 2, 2, 20, 20, 20, 20, 20, -1, 2,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+static const signed char slr_action_value[187] = {
+    -2, -1, 3, 15, 16, 17, 18, 42, 23, 24, 25, 26, 27, 28, 29, 30,
+    66, 31, 32, 33, 34, 35, 36, 37, 38, 39, 48, 67, 23, 24, 25, 26,
+    27, 28, 29, 30, 69, 31, 32, 33, 34, 35, 36, 37, 38, 39, 68, 23,
+    24, 25, 26, 27, 28, 29, 30, 71, 31, 32, 33, 34, 35, 36, 37, 38,
+    39, 23, 24, 25, 26, 27, 28, 29, 30, 0, 31, 32, 33, 34, 35, 36,
+    37, 38, 39, 23, 24, 25, 26, 27, 28, 0, 30, 0, 31, 32, 33, 34,
+    35, 36, 37, 38, 39, 23, 24, 25, 26, 27, 28, 25, 26, 27, 31, 32,
+    33, 34, 35, 36, 37, 38, 39, 23, 24, 25, 26, 27, 0, 0, 0, 0,
+    31, 32, 33, 34, 35, 36, 37, 38, 39, 23, 24, 25, 26, 27, 23, 24,
+    25, 26, 27, 0, 33, 34, 35, 36, 37, 38, 39, 0, 0, 37, 38, 39,
+    8, 9, 0, 0, 10, 0, 0, 11, 12, 23, 24, 25, 26, 27, 0, 13,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static const signed char slr_goto_default[10] = {
+    0, 4, 5, 6, 7, 45, 43, 44, 46, 47,
+};
+
+static const signed char slr_goto_base[10] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static const signed char slr_goto_check[74] = {
+    -1, -1, 5, -1, -1, -1, -1, -1, -1, -1, 5, 5, 5, 5, -1, 5,
+    5, -1, -1, -1, -1, -1, -1, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    5, 5, 5, 5, 5, 5, 5, 5, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, 7, -1, 9, -1, -1, 5, -1, -1,
+};
+
+static const signed char slr_goto_value[74] = {
+    0, 0, 14, 0, 0, 0, 0, 0, 0, 0, 19, 20, 21, 22, 0, 40,
+    41, 0, 0, 0, 0, 0, 0, 49, 50, 51, 52, 53, 54, 55, 56, 57,
+    58, 59, 60, 61, 62, 63, 64, 65, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 70, 0, 72, 0, 0, 73, 0, 0,
+};
+
+// 712 bytes (dense table: 2664 bytes)
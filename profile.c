@@ -0,0 +1,179 @@
+/*
+ * profile.c
+ */
+
+#include "profile.h"
+
+#ifdef MINCALC_PROFILE
+
+#ifdef __FPGA_EXP__
+#error "the profiler needs a host clock"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "io.h"
+#include "strutils.h"
+
+// Calls are profiled per function name.  A frame is pushed for every call;
+// time and nodes spent in callees are subtracted from the caller's
+// exclusive figures.  Arguments are evaluated inside the call and count to
+// the callee.  Inclusive time is only added by the outermost active call of
+// a function, so recursion is not counted twice.
+
+#define PROF_MAX_FUNCS 128
+#define PROF_MAX_DEPTH 1024
+
+typedef struct {
+    char name[4];
+    unsigned long calls;
+    unsigned long nodes;  // evaluated in the function itself
+    int depth;            // active calls
+    int max_depth;
+    uint64_t incl_ns;
+    uint64_t excl_ns;
+} prof_entry_t;
+
+typedef struct {
+    prof_entry_t *entry;  // NULL when the function table is full
+    uint64_t start_ns;
+    uint64_t child_ns;
+    unsigned long start_nodes;
+    unsigned long child_nodes;
+} prof_frame_t;
+
+static prof_entry_t entries[PROF_MAX_FUNCS];
+static size_t nentries;
+static prof_frame_t frames[PROF_MAX_DEPTH];
+static size_t nframes;
+static size_t nlost;  // calls nested deeper than PROF_MAX_DEPTH
+static unsigned long nlines;
+
+unsigned long prof_nodes;
+int prof_per_line;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static prof_entry_t *get_entry(const char *name) {
+    for (size_t i = 0; i < nentries; i++) {
+        prof_entry_t *e = &entries[i];
+        if (e->name[0] == name[0] && e->name[1] == name[1] &&
+            e->name[2] == name[2] && e->name[3] == name[3]) {
+            return e;
+        }
+    }
+    if (nentries == PROF_MAX_FUNCS) {
+        return NULL;
+    }
+    prof_entry_t *e = &entries[nentries++];
+    for (int i = 0; i < 4; i++) {
+        e->name[i] = name[i];
+    }
+    e->calls = 0;
+    e->nodes = 0;
+    e->depth = 0;
+    e->max_depth = 0;
+    e->incl_ns = 0;
+    e->excl_ns = 0;
+    return e;
+}
+
+void prof_enter(const char *name) {
+    if (nframes == PROF_MAX_DEPTH) {
+        nlost++;
+        return;
+    }
+    prof_frame_t *f = &frames[nframes++];
+    prof_entry_t *e = get_entry(name);
+    if (e != NULL) {
+        e->calls++;
+        if (++e->depth > e->max_depth) {
+            e->max_depth = e->depth;
+        }
+    }
+    f->entry = e;
+    f->child_ns = 0;
+    f->start_nodes = prof_nodes;
+    f->child_nodes = 0;
+    f->start_ns = now_ns();
+}
+
+void prof_exit(void) {
+    uint64_t end_ns = now_ns();
+    if (nlost > 0) {
+        nlost--;
+        return;
+    }
+    prof_frame_t *f = &frames[--nframes];
+    uint64_t incl_ns = end_ns - f->start_ns;
+    unsigned long incl_nodes = prof_nodes - f->start_nodes;
+    prof_entry_t *e = f->entry;
+    if (e != NULL) {
+        e->excl_ns += incl_ns - f->child_ns;
+        e->nodes += incl_nodes - f->child_nodes;
+        if (--e->depth == 0) {
+            e->incl_ns += incl_ns;
+        }
+    }
+    if (nframes > 0) {
+        frames[nframes - 1].child_ns += incl_ns;
+        frames[nframes - 1].child_nodes += incl_nodes;
+    }
+}
+
+// Prints the table, most exclusive time first.
+void prof_dump(void) {
+    prof_entry_t *order[PROF_MAX_FUNCS];
+    for (size_t i = 0; i < nentries; i++) {
+        size_t j = i;
+        for (; j > 0 && order[j - 1]->excl_ns < entries[i].excl_ns; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = &entries[i];
+    }
+    mc_puts("func\tcalls\tdepth\tnodes\tincl_us\texcl_us");
+    for (size_t i = 0; i < nentries; i++) {
+        const prof_entry_t *e = order[i];
+        for (int k = 0; k < 4 && e->name[k] != '\0'; k++) {
+            mc_putchar(e->name[k]);
+        }
+        mc_putchar('\t');
+        print_ulong(e->calls);
+        mc_putchar('\t');
+        print_ulong((unsigned long)e->max_depth);
+        mc_putchar('\t');
+        print_ulong(e->nodes);
+        mc_putchar('\t');
+        print_ulong((unsigned long)(e->incl_ns / 1000));
+        mc_putchar('\t');
+        print_ulong((unsigned long)(e->excl_ns / 1000));
+        mc_putchar('\n');
+    }
+    mc_print("total\t");
+    print_ulong(nlines);
+    mc_print(" statements\t");
+    print_ulong(prof_nodes);
+    mc_puts(" nodes");
+}
+
+void prof_reset(void) {
+    nentries = 0;
+    nlines = 0;
+    prof_nodes = 0;
+}
+
+void prof_end_line(void) {
+    nlines++;
+    if (prof_per_line) {
+        prof_dump();
+        prof_reset();
+    }
+}
+
+#endif /* MINCALC_PROFILE */
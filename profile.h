@@ -0,0 +1,36 @@
+/*
+ * profile.h
+ */
+
+#ifndef MINCALC_PROFILE_H
+#define MINCALC_PROFILE_H
+
+// Evaluation profiler, built in with -DMINCALC_PROFILE (make PROFILE=1).
+// Without it the hooks expand to nothing.  Needs a host clock.
+
+#ifdef MINCALC_PROFILE
+
+extern unsigned long prof_nodes;
+extern int prof_per_line;
+
+void prof_enter(const char *name);
+void prof_exit(void);
+void prof_end_line(void);
+void prof_dump(void);
+void prof_reset(void);
+
+#define PROF_NODE() (prof_nodes++)
+#define PROF_ENTER(name) prof_enter(name)
+#define PROF_EXIT() prof_exit()
+#define PROF_END_LINE() prof_end_line()
+
+#else
+
+#define PROF_NODE() ((void)0)
+#define PROF_ENTER(name) ((void)0)
+#define PROF_EXIT() ((void)0)
+#define PROF_END_LINE() ((void)0)
+
+#endif /* MINCALC_PROFILE */
+
+#endif /* MINCALC_PROFILE_H */
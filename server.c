@@ -0,0 +1,321 @@
+/*
+ * server.c
+ */
+
+// Server mode (mincalc -S SOCKET).  A single thread serves all connections
+// from an epoll loop.  Each connection behaves like a console of its own: it
+// is sent the prompt, and every line it sends is run in its session and
+// answered followed by the next prompt.  With -p the connections speak the
+// request protocol instead, without prompts.  Input is run as soon as complete
+// lines arrive, and the output of all lines run for one read goes out in a
+// single send.  While a client leaves too much output unread, its further
+// lines wait.
+
+#ifndef __FPGA_EXP__
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "io.h"
+#include "session.h"
+
+#include "server.h"
+
+#define SERVER_LINE_MAX 1024  // as on the console
+#define SERVER_OUT_HIGH 65536
+#define SERVER_MAX_EVENTS 64
+
+typedef struct {
+    int fd;
+    uint32_t events;  // watched
+    int eof;
+    int out_err;  // output could not be buffered
+    session_t session;
+    calc_env_t env;
+    char in[SERVER_LINE_MAX];
+    size_t in_len;
+    char *out;
+    size_t out_len;
+    size_t out_cap;
+} conn_t;
+
+static int epfd;
+static const calc_env_t *base_env;
+static calc_limits_t conn_limits;
+static int proto_mode;
+static volatile sig_atomic_t stopping;
+static sigset_t run_mask;  // the signal mask while lines run
+
+// the connection mc_putchar writes to
+static conn_t *out_conn;
+
+// Stops the server, cancelling the statement being evaluated, if any.
+static void on_signal(int sig) {
+    (void)sig;
+    stopping = 1;
+    calc_interrupt();
+}
+
+static int conn_put(int c) {
+    conn_t *conn = out_conn;
+    if (conn->out_len == conn->out_cap) {
+        size_t cap = conn->out_cap == 0 ? 4096 : 2 * conn->out_cap;
+        char *p = realloc(conn->out, cap);
+        if (p == NULL) {
+            conn->out_err = 1;
+            return EOF;
+        }
+        conn->out = p;
+        conn->out_cap = cap;
+    }
+    conn->out[conn->out_len++] = (char)c;
+    return c;
+}
+
+static void conn_close(conn_t *c) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    session_close(&c->session);
+    free(c->out);
+    free(c);
+}
+
+// Sends as much buffered output as the socket takes.  Returns 1 if the
+// connection failed.
+static int conn_flush(conn_t *c) {
+    size_t sent = 0;
+    while (sent < c->out_len) {
+        ssize_t n = send(c->fd, c->out + sent, c->out_len - sent,
+                         MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return 1;
+        }
+        sent += (size_t)n;
+    }
+    memmove(c->out, c->out + sent, c->out_len - sent);
+    c->out_len -= sent;
+    return 0;
+}
+
+// Runs the complete lines of the input buffer while the output is not
+// backed up.  A line longer than the buffer is cut, as mc_getsn does.  The
+// signals that stop the server can interrupt the lines, and no more lines
+// run once it is stopping.
+static void conn_run(conn_t *c) {
+    size_t start = 0;
+    sigset_t wait_mask;
+    out_conn = c;
+    mc_set_output(conn_put);
+    sigprocmask(SIG_SETMASK, &run_mask, &wait_mask);
+    while (!stopping && c->out_len < SERVER_OUT_HIGH) {
+        size_t avail = c->in_len - start;
+        char *nl = memchr(c->in + start, '\n', avail);
+        size_t end;
+        if (nl != NULL) {
+            end = (size_t)(nl - c->in) + 1;
+        } else if (avail == SERVER_LINE_MAX - 1) {
+            end = c->in_len;
+        } else {
+            break;
+        }
+        // terminate the line in place
+        char saved = c->in[end];
+        c->in[end] = '\0';
+        session_line(&c->session, c->in + start);
+        c->in[end] = saved;
+        if (!proto_mode) {
+            mc_putchar('>');
+        }
+        start = end;
+    }
+    sigprocmask(SIG_SETMASK, &wait_mask, NULL);
+    mc_set_output(NULL);
+    memmove(c->in, c->in + start, c->in_len - start);
+    c->in_len -= start;
+}
+
+// Watches for input while there is room for it and the output is not
+// backed up, and for writability while output is pending.
+static int conn_watch(conn_t *c) {
+    uint32_t events = 0;
+    if (!c->eof && c->in_len < SERVER_LINE_MAX - 1 &&
+        c->out_len < SERVER_OUT_HIGH) {
+        events |= EPOLLIN;
+    }
+    if (c->out_len > 0) {
+        events |= EPOLLOUT;
+    }
+    if (events == c->events) {
+        return 0;
+    }
+    struct epoll_event ev = {.events = events, .data.ptr = c};
+    c->events = events;
+    return epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+static void conn_event(conn_t *c, uint32_t events) {
+    if (events & EPOLLERR) {
+        conn_close(c);
+        return;
+    }
+    if ((events & (EPOLLIN | EPOLLHUP)) && !c->eof &&
+        c->in_len < SERVER_LINE_MAX - 1) {
+        ssize_t n = read(c->fd, c->in + c->in_len,
+                         SERVER_LINE_MAX - 1 - c->in_len);
+        if (n > 0) {
+            c->in_len += (size_t)n;
+        } else if (n == 0) {
+            c->eof = 1;  // a partial last line is dropped, as on the console
+        } else if (errno != EAGAIN && errno != EINTR) {
+            conn_close(c);
+            return;
+        }
+    }
+    conn_run(c);
+    if (c->out_err || conn_flush(c) != 0 ||
+        (c->eof && c->out_len == 0) || conn_watch(c) != 0) {
+        conn_close(c);
+    }
+}
+
+static void accept_conns(int lfd) {
+    while (1) {
+        int fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept");
+            }
+            return;
+        }
+        conn_t *c = malloc(sizeof(*c));
+        if (c == NULL) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->events = EPOLLIN;
+        c->eof = 0;
+        c->out_err = 0;
+        calc_env_init(&c->env, base_env);
+        session_init(&c->session, &c->env);
+        c->session.proto = proto_mode;
+        c->session.remote = 1;
+        c->session.limits = conn_limits;
+        c->session.ceiling = conn_limits;
+        c->in_len = 0;
+        c->out = NULL;
+        c->out_len = 0;
+        c->out_cap = 0;
+        struct epoll_event ev = {.events = c->events, .data.ptr = c};
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            free(c);
+            continue;
+        }
+        if (!proto_mode) {
+            out_conn = c;
+            conn_put('>');
+        }
+        if (c->out_err || conn_flush(c) != 0 || conn_watch(c) != 0) {
+            conn_close(c);
+        }
+    }
+}
+
+static int listen_on(const char *path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    // a socket left by an earlier server is replaced, other files are not
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, SOMAXCONN) != 0) {
+        perror(path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+int server_run(const char *path, const calc_env_t *base, int proto,
+               const calc_limits_t *limits) {
+    base_env = base;
+    conn_limits = *limits;
+    proto_mode = proto;
+    int lfd = listen_on(path);
+    if (lfd < 0) {
+        return 1;
+    }
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev) != 0) {
+        perror("epoll");
+        close(lfd);
+        unlink(path);
+        return 1;
+    }
+
+    // the signals are only delivered inside epoll_pwait and while lines run,
+    // so none is missed between checking stopping and waiting
+    struct sigaction sa = {.sa_handler = on_signal};
+    sigset_t block;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    sigprocmask(SIG_BLOCK, &block, &run_mask);
+
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    int ret = 0;
+    while (!stopping) {
+        int n = epoll_pwait(epfd, events, SERVER_MAX_EVENTS, -1, &run_mask);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            ret = 1;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) {
+                accept_conns(lfd);
+            } else {
+                conn_event(events[i].data.ptr, events[i].events);
+            }
+        }
+    }
+    close(lfd);
+    close(epfd);
+    unlink(path);
+    return ret;
+}
+
+#endif /* __FPGA_EXP__ */
@@ -0,0 +1,23 @@
+/*
+ * server.h
+ */
+
+#ifndef MINCALC_SERVER_H
+#define MINCALC_SERVER_H
+
+#include "calc.h"
+
+// Serves the console line protocol, or with proto the request protocol of
+// session.c, on the Unix domain socket at path until SIGINT or SIGTERM.
+// Every connection gets an environment of its own, layered over base unless
+// it is NULL, and its statements are held to limits, which it may lower but
+// not lift.  Host only.
+//
+// The connections share one thread, so a statement that runs long holds up
+// all of them: unless a time limit is given with -t, statements are limited
+// to SERVER_TIMEOUT_MS.
+#define SERVER_TIMEOUT_MS 2000
+int server_run(const char *path, const calc_env_t *base, int proto,
+               const calc_limits_t *limits);
+
+#endif /* MINCALC_SERVER_H */
@@ -0,0 +1,647 @@
+/*
+ * session.c
+ */
+
+#ifndef __FPGA_EXP__
+#include <stdlib.h>
+#endif
+
+#include "cse.h"
+#include "export.h"
+#include "io.h"
+#include "lexer.h"
+#include "parser.h"
+#include "profile.h"
+#include "stats.h"
+#include "strutils.h"
+
+#include "session.h"
+
+// the session running the current line
+static session_t *cur;
+
+// In protocol mode, the line of the request being run, its ID, the column
+// of a syntax error in it (1-based, 0 if none) and whether its reply has
+// been started.
+static const char *req_line;
+static const char *req_id;
+static size_t req_id_len;
+static size_t err_col;
+static int replied;
+
+// Starts a reply line, which in protocol mode carries the request ID.
+static void reply_begin(void) {
+    if (cur->proto && req_id_len > 0) {
+        mc_putchar('@');
+        for (size_t i = 0; i < req_id_len; i++) {
+            mc_putchar(req_id[i]);
+        }
+        mc_putchar(' ');
+    }
+    replied = 1;
+}
+
+static void show_caret(size_t pos) {
+    while (pos-- > 0) {
+        mc_putchar(' ');
+    }
+    mc_putchar('^');
+    mc_putchar('\n');
+}
+
+// Echoes line and marks the error at pos.  In protocol mode only the
+// column is kept, for the status line.
+static void show_error(const char *line, const char *pos) {
+    if (cur->proto) {
+        err_col = (size_t)(pos - req_line) + 1;
+        return;
+    }
+    size_t len = mc_strlen(line);
+    mc_print(line);
+    if (len == 0 || line[len - 1] != '\n') {
+        mc_putchar('\n');
+    }
+    show_caret((size_t)(pos - line));
+}
+
+// Parses line.  On success returns 0 and stores the tree in *result, or
+// NULL for an empty line; otherwise the error is shown with a caret and 1
+// is returned.
+static int parse_line(symb_t **result, const char *line, int is_svar) {
+    const char *lineptr = line;
+#ifndef MINCALC_SLR_ONLY
+    if (!is_svar) {
+        if (prec_parse_expr(result, &lineptr) != 0) {
+            show_error(line, lineptr);
+            return 1;
+        }
+        return 0;
+    }
+#endif
+    if (is_svar) {
+        init_slr_svar();
+    } else {
+        init_slr_expr();
+    }
+    token_t tok;
+    int is_empty = 1;
+    while (1) {
+        if (get_next_tok(&tok, &lineptr) != 0) {
+            show_error(line, lineptr);
+            return 1;
+        }
+        if (tok.type == TOK_EOS && is_empty) {
+            *result = NULL;
+            return 0;
+        }
+        is_empty = 0;
+        if (slr_feed_token(&tok) != 0) {
+            show_error(line, lineptr);
+            return 1;
+        }
+        if (tok.type == TOK_EOS) {
+            *result = slr_get_result();
+            if (*result == NULL) {
+                mc_puts("internal error");
+                return 1;
+            }
+            return 0;
+        }
+    }
+}
+
+// Parses and executes one statement, printing a result in the given radix.
+static void run_statement(const char *line, int radix) {
+    int is_svar = mc_strstr(line, ":=") != NULL;
+    symb_t *symb;
+    if (parse_line(&symb, line, is_svar) == 0 && symb != NULL) {
+        STAT_INC(statements);
+        symb = cse_intern(symb);
+        calc_start_statement(&cur->limits);
+        if (is_svar) {
+            if (do_svar(symb, line) == 0) {
+                STAT_INC(evals);
+            }
+        } else {
+            int ans;
+            if (do_eval(&ans, symb) == 0) {
+                char out[36];
+                STAT_INC(evals);
+                mc_format_radix(ans, radix, out);
+                reply_begin();
+                mc_puts(out);
+            }
+        }
+        PROF_END_LINE();
+    }
+    clear_slr_mem();
+}
+
+// =============
+// meta-commands
+// =============
+
+// Lines starting with ':' are commands to the calculator itself rather than
+// statements: ":name args".
+
+#define CMD_DIE(msg)                  \
+    do {                              \
+        mc_error("COMMAND", msg);     \
+        STAT_ERROR(STAT_ERR_COMMAND); \
+        return 1;                     \
+    } while (0)
+
+typedef struct {
+    const char *name;
+    int (*run)(const char *args);
+    int files;  // reads or writes files, so not for remote sessions
+} command_t;
+
+static const char *skip_spaces(const char *s) {
+    while (*s == ' ' || *s == '\t') {
+        s++;
+    }
+    return s;
+}
+
+// If s starts with the word w, returns what follows it with leading spaces
+// removed, otherwise NULL.
+static const char *match_word(const char *s, const char *w) {
+    while (*w != '\0') {
+        if (*s++ != *w++) {
+            return NULL;
+        }
+    }
+    if (*s != '\0' && *s != ' ' && *s != '\t') {
+        return NULL;
+    }
+    return skip_spaces(s);
+}
+
+// :args eager|lazy selects how arguments of user functions are passed; see
+// calc.c for what changes.
+static int cmd_args(const char *args) {
+    static const char *const names[] = {"eager", "lazy"};
+    if (*args == '\0') {
+        mc_puts(names[cur->args]);
+        return 0;
+    }
+    for (int m = CALC_ARGS_EAGER; m <= CALC_ARGS_LAZY; m++) {
+        const char *rest = match_word(args, names[m]);
+        if (rest != NULL && *rest == '\0') {
+            cur->args = (enum calc_args)m;
+            calc_set_args(cur->args);
+            return 0;
+        }
+    }
+    CMD_DIE("usage: :args [eager|lazy]");
+}
+
+// Parses a limit: a decimal count, or "off" for none (0).  Returns 1 if
+// args is neither.
+static int parse_limit(unsigned long *limit, const char *args) {
+    const char *rest = match_word(args, "off");
+    if (rest != NULL && *rest == '\0') {
+        *limit = 0;
+        return 0;
+    }
+    unsigned long n = 0;
+    do {
+        unsigned int d = (unsigned int)(*args - '0');
+        if (d > 9 || n > ((unsigned long)-1 - d) / 10) {
+            return 1;
+        }
+        n = n * 10 + d;
+    } while (*++args != '\0');
+    *limit = n;
+    return 0;
+}
+
+static void print_limit(unsigned long limit) {
+    if (limit == 0) {
+        mc_puts("off");
+    } else {
+        print_ulong(limit);
+        mc_putchar('\n');
+    }
+}
+
+// Whether limit is above ceiling; 0 is no limit.
+static int above(unsigned long limit, unsigned long ceiling) {
+    return ceiling != 0 && (limit == 0 || limit > ceiling);
+}
+
+// :budget NODES and :timeout MS limit each statement of the session; see
+// calc.c.  Server connections may lower the limits the server was started
+// with, but not lift them.
+static int cmd_budget(const char *args) {
+    unsigned long n;
+    if (*args == '\0') {
+        print_limit(cur->limits.nodes);
+        return 0;
+    }
+    if (parse_limit(&n, args) != 0) CMD_DIE("usage: :budget [NODES|off]");
+    if (above(n, cur->ceiling.nodes)) CMD_DIE("above the server's limit");
+    cur->limits.nodes = n;
+    return 0;
+}
+
+// :nesting DEPTH bounds how deeply lines may nest, up to PARSER_MAX_DEPTH;
+// see parser.c.
+static int cmd_nesting(const char *args) {
+    if (*args == '\0') {
+        print_limit(cur->nesting);
+        return 0;
+    }
+    unsigned long depth;
+    if (parse_limit(&depth, args) != 0 || depth == 0)
+        CMD_DIE("usage: :nesting [DEPTH]");
+    if (depth > PARSER_MAX_DEPTH) CMD_DIE("nesting limit too large");
+    cur->nesting = depth;
+    parser_max_depth = depth;
+    return 0;
+}
+
+#ifndef __FPGA_EXP__
+static int cmd_timeout(const char *args) {
+    unsigned long n;
+    if (*args == '\0') {
+        print_limit(cur->limits.ms);
+        return 0;
+    }
+    if (parse_limit(&n, args) != 0) CMD_DIE("usage: :timeout [MS|off]");
+    if (above(n, cur->ceiling.ms)) CMD_DIE("above the server's limit");
+    cur->limits.ms = n;
+    return 0;
+}
+#endif
+
+#ifndef __FPGA_EXP__
+// Unmaps the library images that the environment no longer uses, nor
+// would after a :rollback.
+static void unmap_unused(void) {
+    for (size_t i = 0; i < SESSION_MAPS; i++) {
+        session_map_t *m = &cur->maps[i];
+        if (m->buf != NULL &&
+            !calc_uses_base(cur->env, &((const calc_image_t *)m->buf)->env)) {
+            mc_unmap_file(m->buf, m->size);
+            m->buf = NULL;
+        }
+    }
+}
+#endif
+
+// :begin sets a checkpoint of the variables and functions, :rollback
+// returns to it and :commit keeps what changed since; see calc.c.
+//
+// The undo log of the checkpoints is allocated on the first :begin of a
+// session; the FPGA build has one for its only session.
+static int cmd_begin(const char *args) {
+    if (*args != '\0') CMD_DIE("usage: :begin");
+    if (cur->env->log == NULL) {
+#ifdef __FPGA_EXP__
+        static calc_undo_log_t log;
+        cur->undo_log = &log;
+#else
+        if (cur->undo_log == NULL) {
+            cur->undo_log = malloc(sizeof(*cur->undo_log));
+            if (cur->undo_log == NULL) CMD_DIE("out of memory");
+        }
+#endif
+        calc_set_undo_log(cur->undo_log);
+    }
+    return calc_begin();
+}
+
+static int cmd_rollback(const char *args) {
+    if (*args != '\0') CMD_DIE("usage: :rollback");
+    if (calc_rollback() != 0) return 1;
+#ifndef __FPGA_EXP__
+    unmap_unused();
+#endif
+    return 0;
+}
+
+static int cmd_commit(const char *args) {
+    if (*args != '\0') CMD_DIE("usage: :commit");
+    if (calc_commit() != 0) return 1;
+#ifndef __FPGA_EXP__
+    unmap_unused();
+#endif
+    return 0;
+}
+
+static int cmd_cse(const char *args) {
+    static const char *const names[] = {"off", "on", "keep"};
+    if (*args == '\0') {
+        mc_puts(names[cur->cse]);
+        return 0;
+    }
+    for (int m = CSE_OFF; m <= CSE_KEEP; m++) {
+        const char *rest = match_word(args, names[m]);
+        if (rest != NULL && *rest == '\0') {
+            cur->cse = (enum cse_mode)m;
+            cse_mode = cur->cse;
+            cse_reset();
+            return 0;
+        }
+    }
+    CMD_DIE("usage: :cse [on|off|keep]");
+}
+
+#ifdef MINCALC_PROFILE
+static int cmd_profile(const char *args) {
+    const char *rest;
+    if (*args == '\0') {
+        prof_dump();
+    } else if ((rest = match_word(args, "line")) != NULL && *rest == '\0') {
+        prof_per_line = 1;
+    } else if ((rest = match_word(args, "total")) != NULL && *rest == '\0') {
+        prof_per_line = 0;
+    } else if ((rest = match_word(args, "reset")) != NULL && *rest == '\0') {
+        prof_reset();
+    } else
+        CMD_DIE("usage: :profile [line|total|reset]");
+    return 0;
+}
+#endif
+
+static int cmd_stats(const char *args) {
+    if (*args != '\0') CMD_DIE("usage: :stats");
+    stats_print(mc_putchar);
+    return 0;
+}
+
+// Without arguments sets the radix of results, otherwise runs the rest of
+// the line as a statement with results in that radix.
+static int set_radix(const char *args, int radix) {
+    if (*args == '\0') {
+        cur->out_radix = radix;
+    } else {
+        run_statement(args, radix);
+    }
+    return 0;
+}
+
+static int cmd_hex(const char *args) { return set_radix(args, 16); }
+static int cmd_dec(const char *args) { return set_radix(args, 10); }
+static int cmd_oct(const char *args) { return set_radix(args, 8); }
+static int cmd_bin(const char *args) { return set_radix(args, 2); }
+
+#ifndef __FPGA_EXP__
+static unsigned char snapshot[CALC_SNAPSHOT_MAX];
+
+static int load_snapshot(const char *path) {
+    long size = mc_read_file(path, snapshot, sizeof(snapshot));
+    if (size < 0) CMD_DIE("cannot read snapshot");
+    if (calc_load(snapshot, (size_t)size) != 0) return 1;
+    cse_reset();
+    return 0;
+}
+
+static int cmd_save(const char *args) {
+    if (*args == '\0') CMD_DIE("usage: :save FILE");
+    size_t size = calc_save(snapshot);
+    if (mc_write_file(args, snapshot, size) != 0)
+        CMD_DIE("cannot write snapshot");
+    return 0;
+}
+
+static int cmd_load(const char *args) {
+    if (*args == '\0') CMD_DIE("usage: :load FILE");
+    return load_snapshot(args);
+}
+
+// Libraries are published to a file that is renamed into place, so that
+// the processes that mapped the previous version keep it.
+static calc_image_t image;
+
+// Images stay mapped while the environment or one of its checkpoints has
+// them as base; after unmap_unused at most one per checkpoint and the base
+// are, so a slot is free for the new one.
+static int attach_library(const char *path) {
+    unmap_unused();
+    session_map_t *m = cur->maps;
+    while (m->buf != NULL) {
+        m++;
+    }
+    unsigned long size;
+    const void *buf = mc_map_file(path, &size);
+    if (buf == NULL) CMD_DIE("cannot map library");
+    if (calc_attach(cur->env, buf, size) != 0) {
+        mc_unmap_file(buf, size);
+        return 1;
+    }
+    m->buf = buf;
+    m->size = size;
+    unmap_unused();
+    return 0;
+}
+
+static int cmd_publish(const char *args) {
+    if (*args == '\0') CMD_DIE("usage: :publish FILE");
+    if (calc_publish(&image) != 0) return 1;
+    if (mc_replace_file(args, &image, sizeof(image)) != 0)
+        CMD_DIE("cannot write library");
+    return 0;
+}
+
+static int cmd_attach(const char *args) {
+    if (*args == '\0') CMD_DIE("usage: :attach FILE");
+    return attach_library(args);
+}
+
+// writes the functions as C to PATH.c and PATH.h
+static int cmd_export(const char *args) {
+    if (*args == '\0') CMD_DIE("usage: :export PATH");
+    return export_c(args, &cur->limits);
+}
+#endif
+
+static const command_t commands[] = {
+    {"args", cmd_args, 0},
+#ifndef __FPGA_EXP__
+    {"attach", cmd_attach, 1},
+#endif
+    {"begin", cmd_begin, 0},
+    {"bin", cmd_bin, 0},
+    {"budget", cmd_budget, 0},
+    {"commit", cmd_commit, 0},
+    {"cse", cmd_cse, 0},
+    {"dec", cmd_dec, 0},
+#ifndef __FPGA_EXP__
+    {"export", cmd_export, 1},
+#endif
+    {"hex", cmd_hex, 0},
+#ifndef __FPGA_EXP__
+    {"load", cmd_load, 1},
+#endif
+    {"nesting", cmd_nesting, 0},
+    {"oct", cmd_oct, 0},
+#ifndef __FPGA_EXP__
+    {"publish", cmd_publish, 1},
+#endif
+    {"rollback", cmd_rollback, 0},
+    {"stats", cmd_stats, 0},
+#ifndef __FPGA_EXP__
+    {"timeout", cmd_timeout, 0},
+#endif
+#ifdef MINCALC_PROFILE
+    {"profile", cmd_profile, 0},
+#endif
+#ifndef __FPGA_EXP__
+    {"save", cmd_save, 1},
+#endif
+};
+
+static int do_command(char *line) {
+    size_t len = mc_strlen(line);
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' ||
+                       line[len - 1] == ' ' || line[len - 1] == '\t')) {
+        line[--len] = '\0';
+    }
+    const char *name = skip_spaces(line + 1);
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        const char *args = match_word(name, commands[i].name);
+        if (args != NULL) {
+            if (commands[i].files && cur->remote)
+                CMD_DIE("not available to remote sessions");
+            return commands[i].run(args);
+        }
+    }
+    CMD_DIE("unknown command");
+}
+
+// ========
+// protocol
+// ========
+
+// A request is a line
+//
+//     [@ID ]STATEMENT-OR-COMMAND
+//
+// whose reply ends with one status line: the value of an expression, "OK",
+// or "ERR COLUMN CATEGORY: message", where COLUMN is the 1-based column of
+// a syntax error in the request line or 0.  The status line starts with
+// "@ID " if the request has an ID.  The output of commands such as :stats
+// comes before it.  Blank lines without an ID are ignored.
+static void run_request(char *line) {
+    const char *p = skip_spaces(line);
+    req_line = line;
+    req_id_len = 0;
+    if (*p == '@') {
+        req_id = ++p;
+        while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\n' &&
+               *p != '\r') {
+            p++;
+        }
+        req_id_len = (size_t)(p - req_id);
+        p = skip_spaces(p);
+    } else if (*p == '\0' || *p == '\n' || *p == '\r') {
+        return;
+    }
+    replied = 0;
+    err_col = 0;
+    mc_collect_errors(1);
+    char *req = line + (p - line);
+    if (*req == ':') {
+        do_command(req);
+    } else {
+        run_statement(req, cur->out_radix);
+    }
+    const char *category;
+    const char *msg = mc_collected_error(&category);
+    mc_collect_errors(0);
+    if (msg != NULL) {
+        reply_begin();
+        mc_print("ERR ");
+        print_ulong(err_col);
+        mc_putchar(' ');
+        mc_print(category);
+        mc_print(": ");
+        mc_puts(msg);
+    } else if (!replied) {
+        reply_begin();
+        mc_puts("OK");
+    }
+}
+
+// ========
+// sessions
+// ========
+
+void session_init(session_t *s, calc_env_t *env) {
+    s->env = env;
+    s->out_radix = 10;
+    s->proto = 0;
+    s->remote = 0;
+    s->args = CALC_ARGS_EAGER;
+    s->nesting = PARSER_MAX_DEPTH;
+    s->cse = CSE_ON;
+    s->undo_log = NULL;
+#ifndef __FPGA_EXP__
+    for (size_t i = 0; i < SESSION_MAPS; i++) {
+        s->maps[i].buf = NULL;
+    }
+#endif
+    s->limits.nodes = 0;
+    s->ceiling.nodes = 0;
+#ifndef __FPGA_EXP__
+    s->limits.ms = 0;
+    s->ceiling.ms = 0;
+#endif
+}
+
+#ifndef __FPGA_EXP__
+void session_close(session_t *s) {
+    free(s->undo_log);
+    s->undo_log = NULL;
+    for (size_t i = 0; i < SESSION_MAPS; i++) {
+        session_map_t *m = &s->maps[i];
+        if (m->buf != NULL) {
+            mc_unmap_file(m->buf, m->size);
+            m->buf = NULL;
+        }
+    }
+}
+#endif
+
+// Makes s the session that lines run for.
+static void enter(session_t *s) {
+    cur = s;
+    calc_env = s->env;
+    if (calc_args != s->args) {
+        calc_set_args(s->args);
+    }
+    parser_max_depth = s->nesting;
+    if (cse_mode != s->cse) {
+        cse_mode = s->cse;
+        cse_reset();
+    }
+}
+
+void session_line(session_t *s, char *line) {
+    enter(s);
+    STAT_INC(lines);
+    if (s->proto) {
+        run_request(line);
+        return;
+    }
+    if (line[0] == ':') {
+        do_command(line);
+        return;
+    }
+    run_statement(line, s->out_radix);
+}
+
+#ifndef __FPGA_EXP__
+int session_load(session_t *s, const char *path) {
+    enter(s);
+    return load_snapshot(path);
+}
+
+int session_attach(session_t *s, const char *path) {
+    enter(s);
+    return attach_library(path);
+}
+#endif
@@ -0,0 +1,61 @@
+/*
+ * session.h
+ */
+
+#ifndef MINCALC_SESSION_H
+#define MINCALC_SESSION_H
+
+#include "calc.h"
+#include "cse.h"
+
+#ifndef __FPGA_EXP__
+// A library image mapped by :attach, kept while the environment of the
+// session or one of its checkpoints has it as base.
+typedef struct {
+    const void *buf;  // NULL if unused
+    unsigned long size;
+} session_map_t;
+
+// the base and one per checkpoint, and the image being attached
+#define SESSION_MAPS (CALC_CHECKPOINTS + 2)
+#endif
+
+// A client of the calculator: the console, or a connection in server mode.
+// Each line runs with calc_env set to the environment of its session, and
+// with the settings of the session in effect.
+typedef struct {
+    calc_env_t *env;
+    int out_radix;  // radix of results, set with :hex, :dec, :oct and :bin
+    int proto;      // protocol mode, see session.c; no prompts
+    int remote;     // a server connection: no commands that use files
+    calc_limits_t limits;   // of each statement, :budget and :timeout
+    calc_limits_t ceiling;  // that :budget and :timeout may not lift, or 0
+    enum calc_args args;    // how arguments are passed, set with :args
+    unsigned long nesting;  // deepest nesting parsed, set with :nesting
+    enum cse_mode cse;      // sharing of subexpressions, set with :cse
+    calc_undo_log_t *undo_log;  // of the checkpoints, from the first :begin
+#ifndef __FPGA_EXP__
+    session_map_t maps[SESSION_MAPS];
+#endif
+} session_t;
+
+void session_init(session_t *s, calc_env_t *env);
+#ifndef __FPGA_EXP__
+// Frees the undo log of s and unmaps its library images; its environment
+// must not be used after.
+void session_close(session_t *s);
+#endif
+
+// Runs one input line, a statement or a meta-command.  The line may be
+// modified.
+void session_line(session_t *s, char *line);
+
+#ifndef __FPGA_EXP__
+// Loads a snapshot into the environment of s.
+int session_load(session_t *s, const char *path);
+// Maps the library image published at path (:publish) as the base of the
+// environment of s.
+int session_attach(session_t *s, const char *path);
+#endif
+
+#endif /* MINCALC_SESSION_H */
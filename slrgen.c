@@ -0,0 +1,800 @@
+/*
+ * slrgen.c
+ *
+ * SLR(1) table generator for the mincalc grammar.  Reads a grammar file
+ * (see mincalc.grammar), builds the LR(0) automaton, resolves reductions with
+ * FOLLOW sets and operator precedence, and writes
+ *
+ *   - a header with enum nonterminal and enum grules, and
+ *   - the rules[] table, the compressed action/goto tables and the operator
+ *     tables of the precedence climbing parser for parser.c.
+ *
+ * Runs on the build host only.
+ *
+ * usage: slrgen GRAMMAR ENUM_HEADER TABLE_HEADER
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAXNAME 32
+#define MAXSYMBOLS 64
+#define MAXRULES 128
+#define MAXRHS 6
+#define MAXARGS 3
+#define MAXENTRIES 8
+#define MAXPREC 32
+#define MAXSTATES 128
+#define MAXITEMS 128
+#define MAXCOMB 4096
+#define MAXLINE 512
+
+#define GEN_DIE(...)                  \
+    do {                              \
+        fprintf(stderr, "slrgen: ");  \
+        fprintf(stderr, __VA_ARGS__); \
+        fputc('\n', stderr);          \
+        exit(1);                      \
+    } while (0)
+
+// =======
+// grammar
+// =======
+
+enum assoc { ASSOC_NONE, ASSOC_LEFT, ASSOC_RIGHT };
+
+typedef struct {
+    char name[MAXNAME];
+    int prec;  // 0: none
+    enum assoc assoc;
+} symbol_t;
+
+typedef struct {
+    char name[MAXNAME];
+    int lhs;
+    int len;
+    int rhs[MAXRHS];
+    int nargs;
+    int argpos[MAXARGS];
+    int prec;
+    enum assoc assoc;
+} production_t;
+
+// symbols [0, ntokens) are terminals, [ntokens, nsymbols) nonterminals
+static symbol_t symbols[MAXSYMBOLS];
+static int ntokens, nsymbols;
+static production_t grammar[MAXRULES];
+static int nrules;
+static int end_token = -1;
+static char expr_name[MAXNAME];
+
+static struct {
+    char state_name[MAXNAME];
+    char rule_name[MAXNAME];
+    int rule;
+} entries[MAXENTRIES];
+static int nentries;
+
+// precedence names that are not terminals, for %prec
+static symbol_t prec_names[MAXPREC];
+static int nprec_names;
+
+// right-hand sides are resolved after all rules are read
+static char rhs_names[MAXRULES][MAXRHS][MAXNAME];
+static char prec_ref[MAXRULES][MAXNAME];
+static char lhs_names[MAXRULES][MAXNAME];
+
+static int find_symbol(const char *name) {
+    for (int i = 0; i < nsymbols; i++) {
+        if (strcmp(symbols[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void copy_name(char *dst, const char *src, int lineno) {
+    if (strlen(src) >= MAXNAME) GEN_DIE("line %d: name too long", lineno);
+    strcpy(dst, src);
+}
+
+static int split_words(char *line, char **words, int max) {
+    int n = 0;
+    char *p = strtok(line, " \t\r\n");
+    while (p != NULL) {
+        if (n == max) GEN_DIE("too many words in a line");
+        words[n++] = p;
+        p = strtok(NULL, " \t\r\n");
+    }
+    return n;
+}
+
+static void read_directive(char **words, int n, int lineno) {
+    static int prec_level = 0;
+    if (strcmp(words[0], "%token") == 0) {
+        if (nrules != 0) GEN_DIE("line %d: %%token after rules", lineno);
+        for (int i = 1; i < n; i++) {
+            if (nsymbols == MAXSYMBOLS) GEN_DIE("too many symbols");
+            copy_name(symbols[nsymbols].name, words[i], lineno);
+            nsymbols++;
+        }
+        ntokens = nsymbols;
+    } else if (strcmp(words[0], "%end") == 0) {
+        if (n != 2) GEN_DIE("line %d: usage: %%end TOKEN", lineno);
+        end_token = find_symbol(words[1]);
+        if (end_token < 0) GEN_DIE("line %d: unknown token", lineno);
+    } else if (strcmp(words[0], "%expr") == 0) {
+        if (n != 2) GEN_DIE("line %d: usage: %%expr NONTERMINAL", lineno);
+        copy_name(expr_name, words[1], lineno);
+    } else if (strcmp(words[0], "%entry") == 0) {
+        if (n != 3) GEN_DIE("line %d: usage: %%entry NAME RULE", lineno);
+        if (nentries == MAXENTRIES) GEN_DIE("too many entries");
+        copy_name(entries[nentries].state_name, words[1], lineno);
+        copy_name(entries[nentries].rule_name, words[2], lineno);
+        nentries++;
+    } else if (strcmp(words[0], "%left") == 0 ||
+               strcmp(words[0], "%right") == 0) {
+        enum assoc assoc =
+            strcmp(words[0], "%left") == 0 ? ASSOC_LEFT : ASSOC_RIGHT;
+        prec_level++;
+        for (int i = 1; i < n; i++) {
+            symbol_t *sym;
+            int t = find_symbol(words[i]);
+            if (t >= 0) {
+                sym = &symbols[t];
+            } else {
+                if (nprec_names == MAXPREC) GEN_DIE("too many %%prec names");
+                sym = &prec_names[nprec_names++];
+                copy_name(sym->name, words[i], lineno);
+            }
+            sym->prec = prec_level;
+            sym->assoc = assoc;
+        }
+    } else {
+        GEN_DIE("line %d: unknown directive %s", lineno, words[0]);
+    }
+}
+
+static void read_rule(char **words, int n, int lineno) {
+    // RULE_NAME: NT_LHS -> SYMBOL ... [%prec NAME]
+    size_t namelen = strlen(words[0]);
+    if (n < 3 || words[0][namelen - 1] != ':' || strcmp(words[2], "->") != 0) {
+        GEN_DIE("line %d: malformed rule", lineno);
+    }
+    if (nrules == MAXRULES) GEN_DIE("too many rules");
+    production_t *p = &grammar[nrules];
+    words[0][namelen - 1] = '\0';
+    copy_name(p->name, words[0], lineno);
+    copy_name(lhs_names[nrules], words[1], lineno);
+    for (int i = 3; i < n; i++) {
+        if (strcmp(words[i], "%prec") == 0) {
+            if (i + 2 != n) GEN_DIE("line %d: misplaced %%prec", lineno);
+            copy_name(prec_ref[nrules], words[i + 1], lineno);
+            break;
+        }
+        if (p->len == MAXRHS) GEN_DIE("line %d: rule too long", lineno);
+        size_t len = strlen(words[i]);
+        if (words[i][len - 1] == '*') {
+            if (p->nargs == MAXARGS) GEN_DIE("line %d: too many args", lineno);
+            p->argpos[p->nargs++] = p->len;
+            words[i][len - 1] = '\0';
+        }
+        copy_name(rhs_names[nrules][p->len], words[i], lineno);
+        p->len++;
+    }
+    nrules++;
+}
+
+static void read_grammar(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) GEN_DIE("cannot open %s", path);
+    char line[MAXLINE];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        lineno++;
+        char *comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        char *words[MAXRHS + 8];
+        int n = split_words(line, words, MAXRHS + 8);
+        if (n == 0) {
+            continue;
+        }
+        if (words[0][0] == '%') {
+            read_directive(words, n, lineno);
+        } else {
+            read_rule(words, n, lineno);
+        }
+    }
+    fclose(fp);
+    if (ntokens == 0) GEN_DIE("no %%token declared");
+    if (end_token < 0) GEN_DIE("no %%end declared");
+    if (nentries == 0) GEN_DIE("no %%entry declared");
+
+    // nonterminals are numbered in order of first definition
+    for (int r = 0; r < nrules; r++) {
+        int s = find_symbol(lhs_names[r]);
+        if (s < 0) {
+            if (nsymbols == MAXSYMBOLS) GEN_DIE("too many symbols");
+            s = nsymbols++;
+            strcpy(symbols[s].name, lhs_names[r]);
+        } else if (s < ntokens) {
+            GEN_DIE("rule %s: token %s on the left", grammar[r].name,
+                    lhs_names[r]);
+        }
+        grammar[r].lhs = s;
+    }
+    for (int r = 0; r < nrules; r++) {
+        production_t *p = &grammar[r];
+        for (int i = 0; i < p->len; i++) {
+            p->rhs[i] = find_symbol(rhs_names[r][i]);
+            if (p->rhs[i] < 0) {
+                GEN_DIE("rule %s: undefined symbol %s", p->name,
+                        rhs_names[r][i]);
+            }
+            // by default a rule takes the precedence of its last terminal
+            if (p->rhs[i] < ntokens && symbols[p->rhs[i]].prec != 0) {
+                p->prec = symbols[p->rhs[i]].prec;
+                p->assoc = symbols[p->rhs[i]].assoc;
+            }
+        }
+        if (prec_ref[r][0] != '\0') {
+            int i;
+            for (i = 0; i < nprec_names; i++) {
+                if (strcmp(prec_names[i].name, prec_ref[r]) == 0) {
+                    break;
+                }
+            }
+            if (i == nprec_names) {
+                GEN_DIE("rule %s: unknown precedence %s", p->name,
+                        prec_ref[r]);
+            }
+            p->prec = prec_names[i].prec;
+            p->assoc = prec_names[i].assoc;
+        }
+        for (int j = 0; j < r; j++) {
+            if (strcmp(grammar[j].name, p->name) == 0) {
+                GEN_DIE("rule %s defined twice", p->name);
+            }
+        }
+    }
+    for (int e = 0; e < nentries; e++) {
+        int r;
+        for (r = 0; r < nrules; r++) {
+            if (strcmp(grammar[r].name, entries[e].rule_name) == 0) {
+                break;
+            }
+        }
+        if (r == nrules) GEN_DIE("unknown entry rule %s", entries[e].rule_name);
+        entries[e].rule = r;
+    }
+}
+
+// ===============
+// FIRST / FOLLOW
+// ===============
+
+typedef uint64_t termset_t;
+
+static int nullable[MAXSYMBOLS];
+static termset_t first[MAXSYMBOLS];
+static termset_t follow[MAXSYMBOLS];
+
+static void compute_first_follow(void) {
+    if (ntokens > 64) GEN_DIE("too many tokens");
+    for (int t = 0; t < ntokens; t++) {
+        first[t] = (termset_t)1 << t;
+    }
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int r = 0; r < nrules; r++) {
+            const production_t *p = &grammar[r];
+            int all_nullable = 1;
+            for (int i = 0; i < p->len && all_nullable; i++) {
+                termset_t f = first[p->lhs] | first[p->rhs[i]];
+                if (f != first[p->lhs]) {
+                    first[p->lhs] = f;
+                    changed = 1;
+                }
+                all_nullable = nullable[p->rhs[i]];
+            }
+            if (all_nullable && !nullable[p->lhs]) {
+                nullable[p->lhs] = 1;
+                changed = 1;
+            }
+        }
+    }
+    for (int e = 0; e < nentries; e++) {
+        follow[grammar[entries[e].rule].lhs] |= (termset_t)1 << end_token;
+    }
+    changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int r = 0; r < nrules; r++) {
+            const production_t *p = &grammar[r];
+            termset_t trailer = follow[p->lhs];
+            for (int i = p->len - 1; i >= 0; i--) {
+                int s = p->rhs[i];
+                if (s < ntokens) {
+                    trailer = first[s];
+                    continue;
+                }
+                if ((follow[s] | trailer) != follow[s]) {
+                    follow[s] |= trailer;
+                    changed = 1;
+                }
+                trailer = nullable[s] ? trailer | first[s] : first[s];
+            }
+        }
+    }
+}
+
+// ================
+// LR(0) automaton
+// ================
+
+// an item is (rule, dot) packed as rule * 8 + dot
+#define ITEM(rule, dot) ((rule)*8 + (dot))
+#define ITEM_RULE(item) ((item) / 8)
+#define ITEM_DOT(item) ((item) % 8)
+
+typedef struct {
+    int nkernel;
+    int kernel[MAXITEMS];
+} state_t;
+
+// state 0 is the accepting state: it has no actions
+static state_t states[MAXSTATES];
+static int nstates = 1;
+static int trans[MAXSTATES][MAXSYMBOLS];
+
+static int closure(const state_t *st, int *items) {
+    int n = 0;
+    char added[MAXRULES] = {0};
+    for (int i = 0; i < st->nkernel; i++) {
+        items[n++] = st->kernel[i];
+    }
+    for (int i = 0; i < n; i++) {
+        const production_t *p = &grammar[ITEM_RULE(items[i])];
+        int dot = ITEM_DOT(items[i]);
+        if (dot == p->len || p->rhs[dot] < ntokens) {
+            continue;
+        }
+        for (int r = 0; r < nrules; r++) {
+            if (grammar[r].lhs == p->rhs[dot] && !added[r]) {
+                added[r] = 1;
+                if (n == MAXITEMS) GEN_DIE("too many items");
+                items[n++] = ITEM(r, 0);
+            }
+        }
+    }
+    return n;
+}
+
+static int cmp_int(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+static int find_or_add_state(const state_t *st) {
+    for (int s = 1; s < nstates; s++) {
+        if (states[s].nkernel == st->nkernel &&
+            memcmp(states[s].kernel, st->kernel,
+                   sizeof(int) * (size_t)st->nkernel) == 0) {
+            return s;
+        }
+    }
+    if (nstates == MAXSTATES) GEN_DIE("too many states");
+    states[nstates] = *st;
+    return nstates++;
+}
+
+static int entry_state(int e) {
+    static state_t st;
+    st.nkernel = 1;
+    st.kernel[0] = ITEM(entries[e].rule, 0);
+    return find_or_add_state(&st);
+}
+
+static void build_automaton(void) {
+    for (int e = 0; e < nentries; e++) {
+        entry_state(e);
+    }
+    for (int s = 1; s < nstates; s++) {
+        int items[MAXITEMS];
+        int n = closure(&states[s], items);
+        for (int x = 0; x < nsymbols; x++) {
+            static state_t next;
+            next.nkernel = 0;
+            for (int i = 0; i < n; i++) {
+                const production_t *p = &grammar[ITEM_RULE(items[i])];
+                int dot = ITEM_DOT(items[i]);
+                if (dot < p->len && p->rhs[dot] == x) {
+                    next.kernel[next.nkernel++] = items[i] + 1;
+                }
+            }
+            if (next.nkernel == 0) {
+                continue;
+            }
+            qsort(next.kernel, (size_t)next.nkernel, sizeof(int), cmp_int);
+            trans[s][x] = find_or_add_state(&next);
+        }
+    }
+}
+
+// ===========
+// SLR tables
+// ===========
+
+static int action[MAXSTATES][MAXSYMBOLS];
+
+static int is_entry_rule(int r) {
+    for (int e = 0; e < nentries; e++) {
+        if (entries[e].rule == r) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Resolves a shift/reduce conflict on token t the way yacc does.  Returns
+// nonzero to shift.
+static int prefer_shift(int s, int t, int r) {
+    const production_t *p = &grammar[r];
+    if (p->prec == 0 || symbols[t].prec == 0) {
+        GEN_DIE("shift/reduce conflict in state %d on %s (rule %s)", s,
+                symbols[t].name, p->name);
+    }
+    if (symbols[t].prec != p->prec) {
+        return symbols[t].prec > p->prec;
+    }
+    return p->assoc == ASSOC_RIGHT;
+}
+
+static void build_actions(void) {
+    for (int s = 1; s < nstates; s++) {
+        for (int t = 0; t < ntokens; t++) {
+            action[s][t] = trans[s][t];
+        }
+        int items[MAXITEMS];
+        int n = closure(&states[s], items);
+        for (int i = 0; i < n; i++) {
+            int r = ITEM_RULE(items[i]);
+            const production_t *p = &grammar[r];
+            if (ITEM_DOT(items[i]) != p->len) {
+                continue;
+            }
+            for (int t = 0; t < ntokens; t++) {
+                if (!(follow[p->lhs] >> t & 1)) {
+                    continue;
+                }
+                if (action[s][t] < 0) {
+                    GEN_DIE("reduce/reduce conflict in state %d on %s", s,
+                            symbols[t].name);
+                }
+                if (action[s][t] > 0 && prefer_shift(s, t, r)) {
+                    continue;
+                }
+                action[s][t] = ~r;
+            }
+        }
+    }
+}
+
+// ================================
+// compression (comb vector packing)
+// ================================
+
+typedef struct {
+    int nentries;
+    int col[MAXSTATES];
+    int val[MAXSTATES];
+} sparse_row_t;
+
+static int base[MAXSTATES], check[MAXCOMB], value[MAXCOMB];
+
+// Packs rows into a shared vector so that row r occupies
+// value[base[r] + col] with check[base[r] + col] == r.
+static int pack_rows(const sparse_row_t *rows, int nrows, int width) {
+    int order[MAXSTATES];
+    for (int r = 0; r < nrows; r++) {
+        order[r] = r;
+    }
+    // place the densest rows first
+    for (int i = 1; i < nrows; i++) {
+        for (int j = i; j > 0 && rows[order[j]].nentries >
+                                     rows[order[j - 1]].nentries;
+             j--) {
+            int tmp = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = tmp;
+        }
+    }
+    for (int i = 0; i < MAXCOMB; i++) {
+        check[i] = -1;
+        value[i] = 0;
+    }
+    int len = 0;
+    for (int i = 0; i < nrows; i++) {
+        const sparse_row_t *row = &rows[order[i]];
+        int b = 0;
+        while (1) {
+            if (b + width > MAXCOMB) GEN_DIE("comb vector overflow");
+            int ok = 1;
+            for (int k = 0; k < row->nentries && ok; k++) {
+                ok = check[b + row->col[k]] == -1;
+            }
+            if (ok) {
+                break;
+            }
+            b++;
+        }
+        base[order[i]] = b;
+        for (int k = 0; k < row->nentries; k++) {
+            check[b + row->col[k]] = order[i];
+            value[b + row->col[k]] = row->val[k];
+        }
+        if (b + width > len) {
+            len = b + width;
+        }
+    }
+    return len;
+}
+
+static int emit_array(FILE *fp, const char *name, const int *a, int n) {
+    int lo = 0, hi = 0;
+    for (int i = 0; i < n; i++) {
+        if (a[i] < lo) lo = a[i];
+        if (a[i] > hi) hi = a[i];
+    }
+    const char *type;
+    int size;
+    if (lo >= -128 && hi <= 127) {
+        type = "signed char";
+        size = 1;
+    } else if (lo >= 0 && hi <= 255) {
+        type = "unsigned char";
+        size = 1;
+    } else {
+        type = "short";
+        size = 2;
+    }
+    fprintf(fp, "static const %s %s[%d] = {", type, name, n);
+    for (int i = 0; i < n; i++) {
+        fprintf(fp, i % 16 == 0 ? "\n    %d," : " %d,", a[i]);
+    }
+    fprintf(fp, "\n};\n\n");
+    return size * n;
+}
+
+static int most_common(const int *a, int n) {
+    int best = 0, best_count = 0;
+    for (int i = 0; i < n; i++) {
+        if (a[i] == 0) {
+            continue;
+        }
+        int count = 0;
+        for (int j = 0; j < n; j++) {
+            count += a[j] == a[i];
+        }
+        if (count > best_count) {
+            best = a[i];
+            best_count = count;
+        }
+    }
+    return best;
+}
+
+static int emit_actions(FILE *fp) {
+    int defact[MAXSTATES] = {0};
+    int row_of[MAXSTATES] = {0};
+    static sparse_row_t rows[MAXSTATES];
+    int nrows = 0;
+
+    for (int s = 0; s < nstates; s++) {
+        // default reduction: the most frequent reduction of the state, except
+        // for the entry rules, which must only be reduced at the end of input
+        int reductions[MAXSYMBOLS];
+        for (int t = 0; t < ntokens; t++) {
+            int a = action[s][t];
+            reductions[t] = (a < 0 && !is_entry_rule(~a)) ? a : 0;
+        }
+        defact[s] = most_common(reductions, ntokens);
+
+        static sparse_row_t row;
+        memset(&row, 0, sizeof(row));
+        for (int t = 0; t < ntokens; t++) {
+            int a = action[s][t];
+            if (a != 0 && a != defact[s]) {
+                row.col[row.nentries] = t;
+                row.val[row.nentries] = a;
+                row.nentries++;
+            }
+        }
+        // share identical rows
+        int r;
+        for (r = 0; r < nrows; r++) {
+            if (memcmp(&rows[r], &row, sizeof(row)) == 0) {
+                break;
+            }
+        }
+        if (r == nrows) {
+            rows[nrows++] = row;
+        }
+        row_of[s] = r;
+    }
+
+    int len = pack_rows(rows, nrows, ntokens);
+    int size = 0;
+    size += emit_array(fp, "slr_action_row", row_of, nstates);
+    size += emit_array(fp, "slr_action_default", defact, nstates);
+    size += emit_array(fp, "slr_action_base", base, nrows);
+    size += emit_array(fp, "slr_action_check", check, len);
+    size += emit_array(fp, "slr_action_value", value, len);
+    return size;
+}
+
+static int emit_gotos(FILE *fp) {
+    int nnonterm = nsymbols - ntokens;
+    int defgoto[MAXSYMBOLS] = {0};
+    static sparse_row_t cols[MAXSYMBOLS];
+    for (int nt = 0; nt < nnonterm; nt++) {
+        int column[MAXSTATES];
+        for (int s = 0; s < nstates; s++) {
+            column[s] = trans[s][ntokens + nt];
+        }
+        defgoto[nt] = most_common(column, nstates);
+        cols[nt].nentries = 0;
+        for (int s = 0; s < nstates; s++) {
+            if (column[s] != 0 && column[s] != defgoto[nt]) {
+                cols[nt].col[cols[nt].nentries] = s;
+                cols[nt].val[cols[nt].nentries] = column[s];
+                cols[nt].nentries++;
+            }
+        }
+    }
+    int len = pack_rows(cols, nnonterm, nstates);
+    int size = 0;
+    size += emit_array(fp, "slr_goto_default", defgoto, nnonterm);
+    size += emit_array(fp, "slr_goto_base", base, nnonterm);
+    size += emit_array(fp, "slr_goto_check", check, len);
+    size += emit_array(fp, "slr_goto_value", value, len);
+    return size;
+}
+
+// ======
+// output
+// ======
+
+static const char *grammar_path;
+
+static FILE *open_output(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) GEN_DIE("cannot open %s", path);
+    const char *name = strrchr(path, '/');
+    fprintf(fp,
+            "/*\n * %s\n *\n"
+            " * Generated by slrgen from %s. Do not edit.\n */\n\n",
+            name != NULL ? name + 1 : path, grammar_path);
+    return fp;
+}
+
+static void write_enums(const char *path) {
+    FILE *fp = open_output(path);
+    fprintf(fp, "#ifndef MINCALC_GRAMMAR_H\n#define MINCALC_GRAMMAR_H\n\n");
+    fprintf(fp, "#include \"lexer.h\"\n\n");
+    fprintf(fp, "enum nonterminal {\n");
+    for (int s = ntokens; s < nsymbols; s++) {
+        fprintf(fp, s == ntokens ? "    %s = NTOKTYPE,\n" : "    %s,\n",
+                symbols[s].name);
+    }
+    fprintf(fp, "};\n#define NSYMBOL (%s + 1)\n\n", symbols[nsymbols - 1].name);
+    fprintf(fp, "enum grules {\n");
+    for (int r = 0; r < nrules; r++) {
+        fprintf(fp, "    %s,\n", grammar[r].name);
+    }
+    fprintf(fp, "};\n#define NRULES (%s + 1)\n\n", grammar[nrules - 1].name);
+    fprintf(fp, "#endif /* MINCALC_GRAMMAR_H */\n");
+    fclose(fp);
+}
+
+// Exports the binary (E -> E* op E*) and prefix (E -> op E*) rules of the
+// %expr nonterminal for the precedence climbing parser.
+static void write_operators(FILE *fp) {
+    if (expr_name[0] == '\0') {
+        return;
+    }
+    int e = find_symbol(expr_name);
+    if (e < ntokens) GEN_DIE("%%expr %s is not a nonterminal", expr_name);
+    int infix[MAXSYMBOLS], prefix[MAXSYMBOLS];
+    for (int t = 0; t < ntokens; t++) {
+        infix[t] = prefix[t] = -1;
+    }
+    for (int r = 0; r < nrules; r++) {
+        const production_t *p = &grammar[r];
+        if (p->lhs != e) {
+            continue;
+        }
+        if (p->len == 3 && p->rhs[0] == e && p->rhs[1] < ntokens &&
+            p->rhs[2] == e && p->nargs == 2 && p->argpos[0] == 0 &&
+            p->argpos[1] == 2) {
+            if (p->prec == 0) GEN_DIE("operator rule %s has no precedence",
+                                      p->name);
+            infix[p->rhs[1]] = r;
+        } else if (p->len == 2 && p->rhs[0] < ntokens && p->rhs[1] == e &&
+                   p->nargs == 1 && p->argpos[0] == 1) {
+            if (p->prec == 0) GEN_DIE("operator rule %s has no precedence",
+                                      p->name);
+            prefix[p->rhs[0]] = r;
+        }
+    }
+    const char *names[2] = {"prec_infix", "prec_prefix"};
+    const int *ops[2] = {infix, prefix};
+    for (int k = 0; k < 2; k++) {
+        fprintf(fp, "static const prec_op_t %s[NTOKTYPE] = {\n", names[k]);
+        for (int t = 0; t < ntokens; t++) {
+            int r = ops[k][t];
+            if (r < 0) {
+                fprintf(fp, "    {0, 0, 0},\n");
+            } else {
+                fprintf(fp, "    {%d, %d, ~%s}, // %s\n", grammar[r].prec,
+                        grammar[r].assoc == ASSOC_RIGHT, grammar[r].name,
+                        symbols[t].name);
+            }
+        }
+        fprintf(fp, "};\n\n");
+    }
+}
+
+static void write_tables(const char *path) {
+    FILE *fp = open_output(path);
+
+    // the terminals must mirror enum toktype
+    fprintf(fp, "typedef char slr_check_tokens[(NTOKTYPE == %d", ntokens);
+    for (int t = 0; t < ntokens; t++) {
+        fprintf(fp, " &&\n                               %s == %d",
+                symbols[t].name, t);
+    }
+    fprintf(fp, ") ? 1 : -1];\n\n");
+
+    fprintf(fp, "static const ruledef_entry_t rules[NRULES] = {\n");
+    for (int r = 0; r < nrules; r++) {
+        const production_t *p = &grammar[r];
+        fprintf(fp, "    {%s, %d", symbols[p->lhs].name, p->len);
+        for (int i = 0; i < MAXARGS; i++) {
+            fprintf(fp, ", %d", i < p->nargs ? p->argpos[i] : -1);
+        }
+        fprintf(fp, "}, // %s\n", p->name);
+    }
+    fprintf(fp, "};\n\n");
+
+    write_operators(fp);
+
+    fprintf(fp, "#define SLR_NSTATES %d\n", nstates);
+    for (int e = 0; e < nentries; e++) {
+        fprintf(fp, "#define %s %d\n", entries[e].state_name, entry_state(e));
+    }
+    fprintf(fp, "\n");
+    int size = emit_actions(fp) + emit_gotos(fp);
+    fprintf(fp, "// %d bytes (dense table: %d bytes)\n", size,
+            nstates * nsymbols);
+    fclose(fp);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 4) {
+        fprintf(stderr, "usage: slrgen GRAMMAR ENUM_HEADER TABLE_HEADER\n");
+        return 2;
+    }
+    grammar_path = argv[1];
+    read_grammar(argv[1]);
+    compute_first_follow();
+    build_automaton();
+    build_actions();
+    write_enums(argv[2]);
+    write_tables(argv[3]);
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * stats.c
+ */
+
+#include "strutils.h"
+
+#include "stats.h"
+
+mc_stats_t mc_stats;
+
+static const char *const err_names[STAT_NERR] = {
+    "errors_lexer",
+    "errors_parser",
+    "errors_calc",
+    "errors_command",
+};
+
+static const char *const pool_names[STAT_NPOOL] = {
+    "pool_parser_nodes",
+    "pool_parser_stack",
+    "pool_vars",
+    "pool_fundef_bytes",
+    "pool_cse_nodes",
+    "pool_code_nodes",
+};
+
+static void put_str(int (*put)(int c), const char *s) {
+    while (*s != '\0') {
+        put(*(const unsigned char *)(s++));
+    }
+}
+
+static void put_ulong(int (*put)(int c), unsigned long n) {
+    char buf[24];
+    put_str(put, mc_ultoa(n, buf));
+}
+
+static void put_stat(int (*put)(int c), const char *name, unsigned long n) {
+    put_str(put, name);
+    put('\t');
+    put_ulong(put, n);
+    put('\n');
+}
+
+void stats_print(int (*put)(int c)) {
+    put_stat(put, "lines", mc_stats.lines);
+    put_stat(put, "statements", mc_stats.statements);
+    put_stat(put, "evals", mc_stats.evals);
+    put_stat(put, "calls", mc_stats.calls);
+    put_stat(put, "nodes", mc_stats.nodes);
+    put_stat(put, "lookups", mc_stats.lookups);
+    put_stat(put, "lookup_probes", mc_stats.probes);
+    put_stat(put, "lookup_max_probe", mc_stats.max_probe);
+    for (int i = 0; i < STAT_NERR; i++) {
+        put_stat(put, err_names[i], mc_stats.errors[i]);
+    }
+    for (int i = 0; i < STAT_NPOOL; i++) {
+        put_str(put, pool_names[i]);
+        put('\t');
+        put_ulong(put, mc_stats.pools[i].hwm);
+        put('\t');
+        put_ulong(put, mc_stats.pools[i].size);
+        put('\n');
+    }
+}
+
+#ifndef __FPGA_EXP__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *exit_path;
+static FILE *exit_file;
+
+static int file_put(int c) { return fputc(c, exit_file); }
+
+static void write_at_exit(void) {
+    if ((exit_file = fopen(exit_path, "w")) == NULL) {
+        perror(exit_path);
+        return;
+    }
+    stats_print(file_put);
+    fclose(exit_file);
+}
+
+int stats_write_at_exit(const char *path) {
+    if (exit_path == NULL && atexit(write_at_exit) != 0) {
+        return 1;
+    }
+    exit_path = path;
+    return 0;
+}
+
+#endif
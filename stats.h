@@ -0,0 +1,69 @@
+/*
+ * stats.h
+ */
+
+#ifndef MINCALC_STATS_H
+#define MINCALC_STATS_H
+
+// Interpreter statistics.  The counters are always on and cost one increment
+// or compare each; they are reset only when the program starts.
+
+enum stat_err {
+    STAT_ERR_LEXER,
+    STAT_ERR_PARSER,
+    STAT_ERR_CALC,
+    STAT_ERR_COMMAND,
+    STAT_NERR,
+};
+
+enum stat_pool {
+    STAT_POOL_PARSER_NODES,
+    STAT_POOL_PARSER_STACK,
+    STAT_POOL_VARS,
+    STAT_POOL_FUNDEF_BYTES,
+    STAT_POOL_CSE_NODES,
+    STAT_POOL_CODE_NODES,
+    STAT_NPOOL,
+};
+
+typedef struct {
+    unsigned int hwm;   // high-water mark
+    unsigned int size;  // 0 until the pool is first used
+} stat_pool_t;
+
+typedef struct {
+    unsigned long lines;       // input lines, commands included
+    unsigned long statements;  // statements parsed
+    unsigned long evals;       // statements executed without error
+    unsigned long calls;       // function calls
+    unsigned long nodes;       // tree nodes evaluated
+    unsigned long lookups;     // variable lookups
+    unsigned long probes;      // entries compared by lookups
+    unsigned int max_probe;
+    unsigned long errors[STAT_NERR];
+    stat_pool_t pools[STAT_NPOOL];
+} mc_stats_t;
+
+extern mc_stats_t mc_stats;
+
+#define STAT_INC(field) (mc_stats.field++)
+#define STAT_ERROR(cat) (mc_stats.errors[cat]++)
+#define STAT_POOL(pool, used, sz)                              \
+    do {                                                       \
+        stat_pool_t *stat_p_ = &mc_stats.pools[pool];          \
+        stat_p_->size = (unsigned int)(sz);                    \
+        if ((unsigned int)(used) > stat_p_->hwm) {             \
+            stat_p_->hwm = (unsigned int)(used);               \
+        }                                                      \
+    } while (0)
+
+// Prints the statistics with put, one "name<TAB>value" line each; pools
+// print "name<TAB>high-water<TAB>size".
+void stats_print(int (*put)(int c));
+
+#ifndef __FPGA_EXP__
+// Writes the statistics to path when the program exits.
+int stats_write_at_exit(const char *path);
+#endif
+
+#endif /* MINCALC_STATS_H */
@@ -2,8 +2,10 @@
  * strutils.c
  */
 
+#include <limits.h>
 #include <stdint.h>
 
+#include "arith.h"
 #include "io.h"
 
 #include "strutils.h"
@@ -105,30 +107,185 @@ int mc_atoi(const char *str) {
     return n;
 }
 
-char *mc_itoa(int num, char *s) {
-    static char buf[12];
-    char *p = &buf[11];
-    int neg = 0;
-    if (num == 0) {
-        *(--p) = '0';
-    } else if (num < 0) {
-        neg = 1;
-        num = -num;
+// Converts the len digits at str, two at a time.  Wraps around like the
+// machine arithmetic when the value does not fit.
+int mc_atoi_n(const char *str, size_t len) {
+    uint32_t n = 0;
+    size_t i = 0;
+    if (len % 2 != 0) {
+        n = (uint32_t)(str[i++] - '0');
     }
-    while (num != 0) {
-        unsigned int quot = (unsigned int)num / 10,
-                     rem = (unsigned int)num % 10;
-        *(--p) = (char)('0' + rem);
-        num = (int)quot;
+    for (; i < len; i += 2) {
+        n = n * 100 + (uint32_t)((str[i] - '0') * 10 + (str[i + 1] - '0'));
     }
-    if (neg) {
-        *(--p) = '-';
+    return (int)n;
+}
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const uint32_t powers_of_10[9] = {
+    10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+static size_t count_digits(uint32_t n) {
+    size_t len = 1;
+    while (len < 10 && n >= powers_of_10[len - 1]) {
+        len++;
+    }
+    return len;
+}
+
+// The FPGA core has no divider, so there the quotient is taken with a
+// multiplication by the reciprocal, exact for all 32-bit n.  Define
+// MINCALC_NO_HWDIV to build that variant elsewhere.  Without a multiplier
+// either (MINCALC_SOFTARITH) it is two shift-and-add divisions by 10.
+#if defined(__FPGA_EXP__) && !defined(MINCALC_NO_HWDIV)
+#define MINCALC_NO_HWDIV
+#endif
+
+static uint32_t div100(uint32_t n) {
+#if defined(MINCALC_SOFTARITH)
+    return arith_div10(arith_div10(n));
+#elif defined(MINCALC_NO_HWDIV)
+    return (uint32_t)(((uint64_t)n * 0x51eb851fu) >> 37);
+#else
+    return n / 100;
+#endif
+}
+
+// Writes the digits of n to s from the end, two per step, and returns their
+// number.  Does not terminate s.
+static size_t format_u32(uint32_t n, char *s) {
+    size_t len = count_digits(n);
+    char *p = s + len;
+    while (n >= 100) {
+        uint32_t q = div100(n);
+        const char *d = &digit_pairs[2 * (n - q * 100)];
+        *(--p) = d[1];
+        *(--p) = d[0];
+        n = q;
+    }
+    if (n >= 10) {
+        *(--p) = digit_pairs[2 * n + 1];
+        *(--p) = digit_pairs[2 * n];
+    } else {
+        *(--p) = (char)('0' + n);
     }
-    return mc_strcpy(s, p);
+    return len;
+}
+
+// Writes num in decimal and a terminator to s, which must have room for 12
+// characters, and returns the length.
+size_t mc_format_int(int num, char *s) {
+    if (num < 0) {
+        *s = '-';
+        size_t len = 1 + format_u32(0u - (uint32_t)num, s + 1);
+        s[len] = '\0';
+        return len;
+    }
+    size_t len = format_u32((uint32_t)num, s);
+    s[len] = '\0';
+    return len;
+}
+
+// ===========================================
+// integer from/to binary, octal and hex digits
+// ===========================================
+
+// digit value + 1, 0 for characters that are not hexadecimal digits
+static const unsigned char digit_values[128] = {
+    ['0'] = 1,  ['1'] = 2,  ['2'] = 3,  ['3'] = 4,  ['4'] = 5,  ['5'] = 6,
+    ['6'] = 7,  ['7'] = 8,  ['8'] = 9,  ['9'] = 10, ['a'] = 11, ['b'] = 12,
+    ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16, ['A'] = 11, ['B'] = 12,
+    ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+static const char hex_digits[16] = "0123456789abcdef";
+
+// Returns the value of the hexadecimal digit c, or 16 if c is not one.
+unsigned int mc_digit_value(int c) {
+    if (c < 0 || c >= 128 || digit_values[c] == 0) {
+        return 16;
+    }
+    return digit_values[c] - 1u;
+}
+
+// Converts the len digits at str in base 1 << shift (2, 8 or 16); the
+// digits are the bit pattern of the result.
+int mc_atoi_radix(const char *str, size_t len, int shift) {
+    uint32_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        n = (n << shift) | mc_digit_value(str[i]);
+    }
+    return (int)n;
+}
+
+// Writes num to s with a terminator and returns the length.  Radix 2, 8 and
+// 16 print the 32-bit pattern of num with a 0b, 0o or 0x prefix, so that the
+// output reads back as a literal; anything else prints signed decimal.  s
+// must have room for 35 characters.
+size_t mc_format_radix(int num, int radix, char *s) {
+    int shift = radix == 16 ? 4 : radix == 8 ? 3 : radix == 2 ? 1 : 0;
+    if (shift == 0) {
+        return mc_format_int(num, s);
+    }
+    uint32_t n = (uint32_t)num;
+    size_t len = 1;
+    while (len * (size_t)shift < 32 && (n >> (len * (size_t)shift)) != 0) {
+        len++;
+    }
+    s[0] = '0';
+    s[1] = shift == 4 ? 'x' : shift == 3 ? 'o' : 'b';
+    char *p = s + 2 + len;
+    *p = '\0';
+    for (size_t i = 0; i < len; i++) {
+        *(--p) = hex_digits[n & ((1u << shift) - 1)];
+        n >>= shift;
+    }
+    return 2 + len;
+}
+
+char *mc_itoa(int num, char *s) {
+    mc_format_int(num, s);
+    return s;
+}
+
+char *mc_ultoa(unsigned long num, char *s) {
+    char *p = s;
+#if ULONG_MAX > 0xffffffffu
+    if (num > 0xffffffffu) {
+        // the high part, then nine digits of the low part
+        mc_ultoa(num / 1000000000u, s);
+        p += mc_strlen(s);
+        uint32_t lo = (uint32_t)(num % 1000000000u);
+        for (size_t len = count_digits(lo); len < 9; len++) {
+            *p++ = '0';
+        }
+        num = lo;
+    }
+#endif
+    p[format_u32((uint32_t)num, p)] = '\0';
+    return s;
 }
 
 int print_int(int num) {
-    static char buf[12];
-    mc_itoa(num, buf);
+    char buf[12];
+    mc_format_int(num, buf);
+    return mc_print(buf);
+}
+
+int print_ulong(unsigned long num) {
+    char buf[24];
+    mc_ultoa(num, buf);
     return mc_print(buf);
 }
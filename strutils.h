@@ -15,7 +15,14 @@ size_t mc_strlen(const char *s);
 char *mc_strstr(const char *haystack, const char *needle);
 
 int mc_atoi(const char *str);
+int mc_atoi_n(const char *str, size_t len);
+size_t mc_format_int(int num, char *s);
 char *mc_itoa(int num, char *s);
+unsigned int mc_digit_value(int c);
+int mc_atoi_radix(const char *str, size_t len, int shift);
+size_t mc_format_radix(int num, int radix, char *s);
+char *mc_ultoa(unsigned long num, char *s);
 int print_int(int num);
+int print_ulong(unsigned long num);
 
 #endif /* MINCALC_STRUTILS_H */
@@ -0,0 +1,257 @@
+/*
+ * uart.c
+ */
+
+#include "uart.h"
+
+#ifdef MINCALC_UART
+
+// ========
+// hardware
+// ========
+
+#ifdef MINCALC_UART_SIM
+
+// The host simulates the UART.  Bytes arrive from stdin and leave to
+// stdout at the rate given by MINCALC_UART_BAUD (default 115200, ten bits
+// per byte).  A received byte sits in a one-byte register and is lost if
+// the next one arrives before it is read, as on the FPGA.  With
+// MINCALC_UART_IRQ a timer signal at four times the byte rate stands in
+// for the interrupt.  At exit the number of bytes lost is reported on
+// stderr.
+//
+// Bytes arrive in the CPU time of the process, so the host running other
+// processes does not count as a stall.  For the same reason waiting for an
+// interrupt spins.
+
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t sim_byte_ns;
+static uint64_t sim_rx_next;  // earliest arrival of the next byte
+static uint64_t sim_tx_next;  // the transmitter is busy until then
+static volatile int sim_rx_full;
+static volatile int sim_rx_eof;
+static unsigned char sim_rx_reg;
+static unsigned long sim_lost;  // overrun or dropped for a full ring
+
+static uint64_t sim_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Receives the bytes that have arrived on the line by now; every one but
+// the last overruns the register unless it was read.
+static int sim_rx_ready(void) {
+    uint64_t now = sim_now();
+    while (!sim_rx_eof && sim_rx_next <= now) {
+        struct pollfd pfd = {.fd = STDIN_FILENO, .events = POLLIN};
+        if (poll(&pfd, 1, 0) != 1) {
+            sim_rx_next = now;  // the line is idle
+            break;
+        }
+        unsigned char c;
+        if (read(STDIN_FILENO, &c, 1) != 1) {
+            sim_rx_eof = 1;
+            break;
+        }
+        if (sim_rx_full) {
+            sim_lost++;
+        }
+        sim_rx_reg = c;
+        sim_rx_full = 1;
+        sim_rx_next += sim_byte_ns;
+    }
+    return sim_rx_full;
+}
+
+static int sim_rx_read(void) {
+    sim_rx_full = 0;
+    return sim_rx_reg;
+}
+
+static int sim_tx_ready(void) { return sim_now() >= sim_tx_next; }
+
+static void sim_tx_write(int c) {
+    unsigned char b = (unsigned char)c;
+    if (write(STDOUT_FILENO, &b, 1) != 1) {
+        _exit(1);
+    }
+    sim_tx_next = sim_now() + sim_byte_ns;
+}
+
+static void sim_report(void) {
+    if (sim_lost > 0) {
+        fprintf(stderr, "uart: %lu bytes lost\n", sim_lost);
+    }
+}
+
+#ifdef MINCALC_UART_IRQ
+static void sim_irq(int sig) {
+    (void)sig;
+    uart_service();
+}
+#endif
+
+static void sim_init(void) {
+    const char *baud = getenv("MINCALC_UART_BAUD");
+    long rate = baud != NULL ? atol(baud) : 115200;
+    if (rate <= 0) {
+        rate = 115200;
+    }
+    sim_byte_ns = 10000000000u / (uint64_t)rate;
+    sim_rx_next = sim_now();
+    atexit(sim_report);
+#ifdef MINCALC_UART_IRQ
+    struct sigaction sa = {.sa_handler = sim_irq, .sa_flags = SA_RESTART};
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGALRM, &sa, NULL);
+    struct itimerval it;
+    it.it_interval.tv_sec = 0;
+    it.it_interval.tv_usec = (suseconds_t)(sim_byte_ns / 4000 + 1);
+    it.it_value = it.it_interval;
+    setitimer(ITIMER_REAL, &it, NULL);
+#endif
+}
+
+#define HW_INIT() sim_init()
+#define HW_RX_READY() sim_rx_ready()
+#define HW_RX_READ() sim_rx_read()
+#define HW_TX_READY() sim_tx_ready()
+#define HW_TX_WRITE(c) sim_tx_write(c)
+#define HW_TX_IRQ(on) ((void)0)
+#define HW_IDLE() ((void)0)
+
+#else
+
+// Besides the blocking UART_SEND_CHAR and UART_RECV_CHAR the board header
+// has to provide, for the ring backend,
+//
+//   UART_RX_READY()   a received byte is waiting
+//   UART_RX_READ()    takes the received byte
+//   UART_TX_READY()   the transmitter takes a byte
+//   UART_TX_WRITE(c)  transmits c
+//
+// and with MINCALC_UART_IRQ, where the UART interrupt calls uart_service,
+//
+//   UART_IRQ_ENABLE() enables the receive interrupt
+//   UART_TX_IRQ(on)   enables or disables the transmitter-ready interrupt
+//   UART_IDLE()       waits for an interrupt, or nothing
+
+#include <uart_sendrecv.h>
+
+#ifdef MINCALC_UART_IRQ
+#define HW_INIT() UART_IRQ_ENABLE()
+#define HW_TX_IRQ(on) UART_TX_IRQ(on)
+#define HW_IDLE() UART_IDLE()
+#else
+#define HW_INIT() ((void)0)
+#endif
+#define HW_RX_READY() UART_RX_READY()
+#define HW_RX_READ() UART_RX_READ()
+#define HW_TX_READY() UART_TX_READY()
+#define HW_TX_WRITE(c) UART_TX_WRITE(c)
+
+#endif /* MINCALC_UART_SIM */
+
+// =====
+// rings
+// =====
+
+// Each ring has one producer and one consumer, uart_service being one of
+// them, so the free-running indices need no locking: only the producer
+// advances head and only the consumer advances tail.
+
+static volatile unsigned char rx_buf[UART_RX_SIZE];
+static volatile unsigned int rx_head;
+static volatile unsigned int rx_tail;
+static volatile unsigned char tx_buf[UART_TX_SIZE];
+static volatile unsigned int tx_head;
+static volatile unsigned int tx_tail;
+static int initialized;
+
+void uart_service(void) {
+    while (HW_RX_READY()) {
+        int c = HW_RX_READ();
+        if (rx_head - rx_tail == UART_RX_SIZE) {
+#ifdef MINCALC_UART_SIM
+            sim_lost++;
+#endif
+            continue;
+        }
+        rx_buf[rx_head % UART_RX_SIZE] = (unsigned char)c;
+        rx_head++;
+    }
+    while (tx_head != tx_tail && HW_TX_READY()) {
+        HW_TX_WRITE(tx_buf[tx_tail % UART_TX_SIZE]);
+        tx_tail++;
+    }
+#ifdef MINCALC_UART_IRQ
+    if (tx_head == tx_tail) {
+        HW_TX_IRQ(0);
+    }
+#endif
+}
+
+static void uart_init(void) {
+    initialized = 1;
+    HW_INIT();
+}
+
+// Waits for the rings to move.
+static void uart_wait(void) {
+#ifdef MINCALC_UART_IRQ
+    HW_IDLE();
+#else
+    uart_service();
+#endif
+}
+
+int uart_getc(void) {
+    if (!initialized) {
+        uart_init();
+    }
+    while (rx_head == rx_tail) {
+#ifdef MINCALC_UART_SIM
+        if (sim_rx_eof && !sim_rx_full) {
+            uart_flush();
+            exit(0);
+        }
+#endif
+        uart_wait();
+    }
+    int c = rx_buf[rx_tail % UART_RX_SIZE];
+    rx_tail++;
+    return c;
+}
+
+void uart_putc(int c) {
+    if (!initialized) {
+        uart_init();
+    }
+    while (tx_head - tx_tail == UART_TX_SIZE) {
+        uart_wait();
+    }
+    tx_buf[tx_head % UART_TX_SIZE] = (unsigned char)c;
+    tx_head++;
+#ifdef MINCALC_UART_IRQ
+    HW_TX_IRQ(1);
+#else
+    uart_service();
+#endif
+}
+
+void uart_flush(void) {
+    while (tx_head != tx_tail) {
+        uart_wait();
+    }
+}
+
+#endif /* MINCALC_UART */
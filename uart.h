@@ -0,0 +1,42 @@
+/*
+ * uart.h
+ */
+
+#ifndef MINCALC_UART_H
+#define MINCALC_UART_H
+
+// Ring-buffered UART I/O behind mc_putchar and mc_getchar.  It is built for
+// the FPGA with -DMINCALC_UART_RING, and simulated on the host with
+// -DMINCALC_UART_SIM (make UART_SIM=1).  uart_service moves bytes between
+// the UART and the rings.  With -DMINCALC_UART_IRQ it runs as the UART
+// interrupt handler.  Otherwise it is polled while waiting for I/O and,
+// through UART_POLL, during evaluation, so that input typed or pasted
+// meanwhile is not lost.
+
+#if defined(MINCALC_UART_RING) || defined(MINCALC_UART_SIM)
+#define MINCALC_UART
+#endif
+
+#ifdef MINCALC_UART
+
+#define UART_RX_SIZE 256  // powers of two
+#define UART_TX_SIZE 256
+
+void uart_service(void);
+int uart_getc(void);
+void uart_putc(int c);
+void uart_flush(void);
+
+#endif /* MINCALC_UART */
+
+// Called with a counter that advances once per unit of work, such as a
+// node evaluated.
+#if defined(MINCALC_UART) && !defined(MINCALC_UART_IRQ)
+#define UART_POLL_EVERY 64
+#define UART_POLL(count) \
+    ((count) % UART_POLL_EVERY == 0 ? uart_service() : (void)0)
+#else
+#define UART_POLL(count) ((void)0)
+#endif
+
+#endif /* MINCALC_UART_H */